@@ -0,0 +1,458 @@
+#include "alloc-counter.h"
+#include "analysis-scheduler.h"
+#include "analysis-worker.h"
+#include "audio-processing.h"
+#include "audio-processor.h"
+#include "band-map.h"
+#include "beat-tracker.h"
+#include "frame-pacer.h"
+#include "loudness-meter.h"
+#include "multi-resolution.h"
+#include "renderers.h"
+#include "shared-spectrum.h"
+#include "simd-kernels.h"
+#include "spectrum-analyzer.h"
+#include "spsc-ring.h"
+#include "stft.h"
+#include "synth-reader.h"
+#include "wave-synth.h"
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <span>
+#include <thread>
+#include <vector>
+
+// Every benchmark iteration is one frame (or one capture quantum), so the
+// reported time is ns/frame and the allocs/frame counter is the number of
+// heap allocations per frame.
+
+#ifdef AUDIO_VISUALIZER_ALLOC_CHECK
+// audio_core already replaces operator new and counts.
+static uint64_t allocationCount() { return audio::processAllocationCount(); }
+#else
+static std::atomic<uint64_t> allocation_count{0};
+static uint64_t allocationCount() { return allocation_count.load(); }
+
+void *operator new(size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (void *ptr = std::malloc(size ? size : 1))
+    return ptr;
+  throw std::bad_alloc();
+}
+// The spectrum arrays are AlignedVectors, which allocate through these.
+void *operator new(size_t size, std::align_val_t alignment) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  const size_t align = static_cast<size_t>(alignment);
+  size = size ? size : 1;
+  if (void *ptr = std::aligned_alloc(align, (size + align - 1) / align * align))
+    return ptr;
+  throw std::bad_alloc();
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+#endif
+
+namespace {
+
+constexpr size_t kSampleRate = 48000;
+
+class AllocationCounter {
+public:
+  explicit AllocationCounter(benchmark::State &state)
+      : state_(state), start_(allocationCount()) {}
+  ~AllocationCounter() {
+    state_.counters["allocs/frame"] =
+        benchmark::Counter(double(allocationCount() - start_),
+                           benchmark::Counter::kAvgIterations);
+  }
+
+private:
+  benchmark::State &state_;
+  uint64_t start_;
+};
+
+// Interleaved music-like test signal: a few partials over pink noise.
+std::vector<float> testSignal(size_t frames, size_t channels) {
+  audio::SynthReader sines(
+      {.kind = audio::SynthKind::kSines,
+       .format = {.sample_rate = kSampleRate, .channels = channels},
+       .frequencies = {55.0f, 440.0f, 1250.0f, 5200.0f}});
+  audio::SynthReader noise(
+      {.kind = audio::SynthKind::kPinkNoise,
+       .format = {.sample_rate = kSampleRate, .channels = channels},
+       .amplitude = 0.1f});
+  std::vector<float> signal(frames * channels), extra(frames * channels);
+  sines.Read(signal.data(), frames);
+  noise.Read(extra.data(), frames);
+  for (size_t i = 0; i < signal.size(); ++i)
+    signal[i] += extra[i];
+  return signal;
+}
+
+struct PlanarSignal {
+  PlanarSignal(size_t frames, size_t channels)
+      : rows(channels, std::vector<float>(frames)) {
+    auto interleaved = testSignal(frames, channels);
+    for (size_t c = 0; c < channels; ++c) {
+      for (size_t i = 0; i < frames; ++i)
+        rows[c][i] = interleaved[i * channels + c];
+      pointers.push_back(rows[c].data());
+    }
+  }
+  audio::StftFrame Frame() const {
+    return {.channels = pointers.data(),
+            .channel_count = rows.size(),
+            .size = rows[0].size()};
+  }
+
+  std::vector<std::vector<float>> rows;
+  std::vector<const float *> pointers;
+};
+
+audio::ProcessedAudioBuffer processedTestBuffer(size_t size) {
+  PlanarSignal signal(size, 1);
+  audio::ProcessedAudioFrame frame(size / 2 + 1);
+  audio::computeFFTMultichannel(signal.Frame(), kSampleRate, frame);
+  return frame.mid;
+}
+
+void BM_ComputeFFT64(benchmark::State &state) {
+  const size_t size = state.range(0);
+  std::vector<float> samples = testSignal(size, 1);
+  audio::ProcessedAudioBuffer output(size / 2 + 1);
+  audio::computeFFT64(samples, kSampleRate, output); // warm up
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    audio::computeFFT64(samples, kSampleRate, output);
+    benchmark::DoNotOptimize(output.max_amplitude);
+  }
+}
+BENCHMARK(BM_ComputeFFT64)->RangeMultiplier(2)->Range(512, 8192);
+
+void BM_ComputeFFTMultichannel(benchmark::State &state) {
+  const size_t size = state.range(0);
+  PlanarSignal signal(size, state.range(1));
+  audio::ProcessedAudioFrame output(size / 2 + 1);
+  audio::computeFFTMultichannel(signal.Frame(), kSampleRate, output);
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    audio::computeFFTMultichannel(signal.Frame(), kSampleRate, output);
+    benchmark::DoNotOptimize(output.mid.max_amplitude);
+  }
+}
+BENCHMARK(BM_ComputeFFTMultichannel)
+    ->ArgsProduct({{1024, 4096}, {1, 2, 6}});
+
+// Same work as BM_ComputeFFTMultichannel through the compile-time specialised
+// path.
+template <size_t size, size_t channels>
+void BM_ComputeFFTMultichannelFixed(benchmark::State &state) {
+  PlanarSignal signal(size, channels);
+  audio::ProcessedAudioFrame output(size / 2 + 1);
+  audio::computeFFTMultichannelFixed<size, channels>(signal.Frame(),
+                                                     kSampleRate, output);
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    audio::computeFFTMultichannelFixed<size, channels>(signal.Frame(),
+                                                       kSampleRate, output);
+    benchmark::DoNotOptimize(output.mid.max_amplitude);
+  }
+}
+BENCHMARK(BM_ComputeFFTMultichannelFixed<1024, 1>);
+BENCHMARK(BM_ComputeFFTMultichannelFixed<1024, 2>);
+BENCHMARK(BM_ComputeFFTMultichannelFixed<4096, 1>);
+BENCHMARK(BM_ComputeFFTMultichannelFixed<4096, 2>);
+
+// Through the type-erased wrapper, as AudioProcessor runs it. 6 channels
+// fall back to the runtime sized path.
+void BM_SpectrumAnalyzer(benchmark::State &state) {
+  const size_t size = state.range(0);
+  PlanarSignal signal(size, state.range(1));
+  audio::ProcessedAudioFrame output(size / 2 + 1);
+  auto analyzer = audio::makeSpectrumAnalyzer(size, state.range(1));
+  analyzer->Analyze(signal.Frame(), kSampleRate, output); // warm up
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    analyzer->Analyze(signal.Frame(), kSampleRate, output);
+    benchmark::DoNotOptimize(output.mid.max_amplitude);
+  }
+}
+BENCHMARK(BM_SpectrumAnalyzer)->ArgsProduct({{1024, 4096}, {1, 2, 6}});
+
+// Octave levels over a window_size window: bass bins of 48000 / (1024 << 3)
+// = 5.9 Hz at level 4 for the price of four 1024 point FFTs.
+void BM_MultiResolution(benchmark::State &state) {
+  const size_t size = state.range(0);
+  const size_t levels = state.range(1);
+  PlanarSignal signal(size, 2);
+  audio::MultiResolutionAnalyzer analyzer(levels);
+  audio::ProcessedAudioFrame output(
+      audio::MultiResolutionAnalyzer::BinCount(size, levels));
+  audio::StftFrame frame = signal.Frame();
+  frame.new_samples = size / 4;
+  analyzer.Process(frame, kSampleRate, output);
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    analyzer.Process(frame, kSampleRate, output);
+    benchmark::DoNotOptimize(output.mid.max_amplitude);
+  }
+  state.counters["bins"] = output.mid.magnitudes.size();
+}
+BENCHMARK(BM_MultiResolution)->ArgsProduct({{1024, 2048}, {1, 4, 6}});
+
+void BM_BandReduce(benchmark::State &state) {
+  const size_t size = 4096;
+  const auto &map = audio::BandMap::Get(
+      {.fft_size = size,
+       .sample_rate = kSampleRate,
+       .scale = static_cast<audio::BandScale>(state.range(0)),
+       .band_count = 128});
+  std::vector<float> magnitudes(size / 2 + 1);
+  for (size_t i = 0; i < magnitudes.size(); ++i)
+    magnitudes[i] = float(i % 97) / 97.0f;
+  std::vector<float> amplitudes(map.size());
+  std::vector<float> frequencies(map.size());
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    map.Reduce(magnitudes.data(), amplitudes.data(), frequencies.data());
+    benchmark::DoNotOptimize(amplitudes.data());
+  }
+  state.counters["bands"] = map.size();
+}
+BENCHMARK(BM_BandReduce)->DenseRange(0, 4);
+
+// Per hop cost of onset detection and tempo tracking on a band spectrum.
+void BM_BeatTracker(benchmark::State &state) {
+  auto buffer = processedTestBuffer(4096);
+  audio::BeatTracker tracker;
+  audio::BeatInfo beat;
+  const float hop_seconds = 1024.0f / kSampleRate;
+  tracker.Process(buffer, hop_seconds, beat);
+  AllocationCounter allocations(state);
+  size_t hop = 0;
+  for (auto _ : state) {
+    // Alternate loudness so flux is not always zero.
+    buffer.max_amplitude = hop++ % 8 == 0 ? 200.0f : 100.0f;
+    tracker.Process(buffer, hop_seconds, beat);
+    benchmark::DoNotOptimize(beat.bpm);
+  }
+}
+BENCHMARK(BM_BeatTracker);
+
+// Metering one hop of new samples, the per-frame cost inside OnNewSample.
+void BM_LoudnessMeter(benchmark::State &state) {
+  const size_t hop = 1024;
+  PlanarSignal signal(4096, state.range(0));
+  audio::StftFrame frame = signal.Frame();
+  frame.new_samples = hop;
+  audio::LoudnessMeter meter;
+  audio::LevelInfo levels;
+  meter.Process(frame, kSampleRate, levels);
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    meter.Process(frame, kSampleRate, levels);
+    benchmark::DoNotOptimize(levels.momentary_lufs);
+  }
+}
+BENCHMARK(BM_LoudnessMeter)->Arg(1)->Arg(2)->Arg(8);
+
+void BM_ProcessorOnNewSample(benchmark::State &state) {
+  const size_t size = state.range(0);
+  PlanarSignal signal(size, state.range(1));
+  audio::AudioProcessor processor("bench", kSampleRate, size);
+  processor.OnNewSample(signal.Frame());
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    processor.OnNewSample(signal.Frame());
+    // Publication round trip, as the render loop would consume it.
+    benchmark::DoNotOptimize(processor.Buffer().mid.avg_amplitude);
+  }
+}
+BENCHMARK(BM_ProcessorOnNewSample)->ArgsProduct({{1024, 4096}, {1, 2}});
+
+// The copy into shared memory a publishing processor adds to every frame.
+void BM_SharedSpectrumWrite(benchmark::State &state) {
+  const size_t size = state.range(0);
+  PlanarSignal signal(size, 2);
+  audio::ProcessedAudioFrame frame(size / 2 + 1);
+  audio::computeFFTMultichannel(signal.Frame(), kSampleRate, frame);
+  audio::SharedSpectrumWriter writer(audio::sharedSpectrumName("bench"));
+  writer.Write(frame, kSampleRate);
+  AllocationCounter allocations(state);
+  for (auto _ : state)
+    writer.Write(frame, kSampleRate);
+}
+BENCHMARK(BM_SharedSpectrumWrite)->Arg(1024)->Arg(4096);
+
+// The copy AudioStream::OnProcess does once PipeWire handed it a buffer:
+// a quantum of interleaved samples into the analysis ring. Drained on the
+// same thread so the ring never fills up.
+void BM_OnProcessCopy(benchmark::State &state) {
+  const size_t quantum = state.range(0);
+  const size_t channels = 2;
+  auto samples = testSignal(quantum, channels);
+  std::vector<float> drained(samples.size());
+  audio::SpscRing<float> ring(1 << 16);
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    ring.Write(samples.data(), samples.size());
+    ring.Read(drained.data(), drained.size());
+  }
+  benchmark::DoNotOptimize(drained.data());
+}
+BENCHMARK(BM_OnProcessCopy)->Arg(256)->Arg(1024);
+
+// Full AnalysisWorker::Push including the wakeup, with the worker running.
+// The bench pushes far faster than real time, so dropped shows how much the
+// worker could not keep up with.
+void BM_AnalysisWorkerPush(benchmark::State &state) {
+  const size_t quantum = state.range(0);
+  const size_t channels = 2;
+  auto samples = testSignal(quantum, channels);
+  audio::AnalysisWorker worker("bench", {.window_size = 4096, .hop_size = 1024},
+                               1 << 16, [](const audio::StftFrame &) {});
+  worker.Start();
+  AllocationCounter allocations(state);
+  for (auto _ : state)
+    worker.Push(samples.data(), quantum, channels);
+  worker.Stop();
+  auto stats = worker.GetStats();
+  state.counters["dropped"] = benchmark::Counter(
+      double(stats.dropped_samples) / (stats.dropped_samples +
+                                       stats.pushed_samples),
+      benchmark::Counter::kDefaults);
+}
+BENCHMARK(BM_AnalysisWorkerPush)->Arg(256)->Arg(1024);
+
+// Full analysis of many sources at once, each iteration pushes a hop into
+// every source and waits until all of them produced their frame. Threads 0
+// gives every source a thread of its own, otherwise they share a scheduler
+// with that many threads.
+void BM_AnalysisScheduler(benchmark::State &state) {
+  const size_t sources = state.range(0);
+  const size_t threads = state.range(1);
+  const size_t channels = 2;
+  const audio::StftOptions stft{.window_size = 4096, .hop_size = 1024};
+  auto samples = testSignal(stft.hop_size, channels);
+
+  std::unique_ptr<audio::AnalysisScheduler> scheduler;
+  if (threads > 0)
+    scheduler = std::make_unique<audio::AnalysisScheduler>(
+        audio::AnalysisSchedulerOptions{.threads = threads});
+  std::atomic<uint64_t> frames{0};
+  std::vector<std::unique_ptr<audio::AudioProcessor>> processors;
+  std::vector<std::unique_ptr<audio::AnalysisWorker>> workers;
+  for (size_t i = 0; i < sources; ++i) {
+    processors.push_back(std::make_unique<audio::AudioProcessor>(
+        "bench", kSampleRate, stft.window_size));
+    audio::AudioProcessor *processor = processors.back().get();
+    workers.push_back(std::make_unique<audio::AnalysisWorker>(
+        "bench", stft, 1 << 16,
+        [processor, &frames](const audio::StftFrame &frame) {
+          processor->OnNewSample(frame);
+          frames.fetch_add(1, std::memory_order_relaxed);
+        },
+        audio::AnalysisWorkerOptions{.scheduler = scheduler.get()}));
+    workers.back()->Start();
+  }
+
+  // A frame per hop once the first window is full.
+  const uint64_t warmup_hops = stft.window_size / stft.hop_size - 1;
+  uint64_t hops = 0;
+  for (auto _ : state) {
+    for (auto &worker : workers)
+      worker->Push(samples.data(), stft.hop_size, channels);
+    ++hops;
+    const uint64_t expected =
+        hops > warmup_hops ? (hops - warmup_hops) * sources : 0;
+    while (frames.load(std::memory_order_relaxed) < expected)
+      std::this_thread::yield();
+  }
+  for (auto &worker : workers)
+    worker->Stop();
+  state.SetItemsProcessed(frames.load());
+  if (scheduler) {
+    const auto stats = scheduler->GetStats();
+    state.counters["steals"] =
+        stats.runs == 0 ? 0.0 : double(stats.steals) / stats.runs;
+  }
+}
+BENCHMARK(BM_AnalysisScheduler)
+    ->ArgsProduct({{4, 16, 48}, {0, 1, 2, 4, 8}})
+    ->UseRealTime();
+
+// Worker side of the capture path: deinterleave a quantum and feed the STFT.
+void BM_DeinterleaveStft(benchmark::State &state) {
+  const size_t quantum = 1024;
+  const size_t channels = state.range(0);
+  auto samples = testSignal(quantum, channels);
+  std::vector<std::vector<float>> planar(channels,
+                                         std::vector<float>(quantum));
+  std::vector<float *> rows;
+  for (auto &row : planar)
+    rows.push_back(row.data());
+  audio::Stft stft({.window_size = 4096, .hop_size = 1024}, channels);
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    audio::deinterleave(samples.data(), quantum, channels, rows.data());
+    stft.Push(rows.data(), quantum, [](const audio::StftFrame &frame) {
+      benchmark::DoNotOptimize(frame.channels);
+    });
+  }
+}
+BENCHMARK(BM_DeinterleaveStft)->Arg(1)->Arg(2)->Arg(6);
+
+void BM_LoudestComponents(benchmark::State &state) {
+  auto buffer = processedTestBuffer(state.range(0));
+  std::array<audio::WaveComponent, audio::kMaxWaveComponents> components;
+  AllocationCounter allocations(state);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(audio::loudestComponents(
+        buffer, state.range(1), true, components.data()));
+}
+BENCHMARK(BM_LoudestComponents)->ArgsProduct({{1024, 4096}, {3, 10, 32}});
+
+// One analysis frame arriving per iteration, with the display halfway between
+// it and the previous one: the copy into the queue plus one full blend.
+void BM_FramePacer(benchmark::State &state) {
+  audio::ProcessedAudioFrame frame(state.range(0));
+  frame.mid = processedTestBuffer(state.range(0));
+  audio::FramePacer pacer;
+  constexpr int64_t hop_ns = 21333333;
+  int64_t now_ns = 0;
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    now_ns += hop_ns;
+    frame.timing.capture_ns = now_ns;
+    frame.timing.publish_ns = now_ns;
+    pacer.Push(frame, now_ns);
+    benchmark::DoNotOptimize(&pacer.Spectrum(now_ns + hop_ns / 2));
+  }
+}
+BENCHMARK(BM_FramePacer)->Arg(1024)->Arg(4096);
+
+void BM_ComputeWavePoints(benchmark::State &state) {
+  auto buffer = processedTestBuffer(1024);
+  WaveOptions options;
+  options.wave_count = state.range(0);
+  std::array<Vector2, drawable_width> points{};
+  float time = 0.0f;
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    time += 1.0f / 60.0f;
+    ComputeWavePoints(buffer, options, 0.0f, time, points);
+    benchmark::DoNotOptimize(points.data());
+  }
+}
+BENCHMARK(BM_ComputeWavePoints)->Arg(3)->Arg(10)->Arg(32);
+
+} // namespace
+
+BENCHMARK_MAIN();
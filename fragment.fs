@@ -1,16 +1,47 @@
+#version 330
 
-    #version 330
+// Batched bar renderer: the whole bar area is one quad textured with the bar
+// heights (one R32 texel per bar, in pixels). Every fragment works out which
+// bar it belongs to and whether it lies inside it.
 
-    in vec2 fragTexCoord;
-    in vec4 fragColor;
+in vec2 fragTexCoord;
+in vec4 fragColor;
 
-    out vec4 finalColor;
+uniform sampler2D texture0;
+uniform float barCount;
+uniform float barWidth;
+uniform vec2 size;
+uniform float posYOffset;
+uniform float hueStart;
+uniform float hueRange;
+uniform float hueSpeed;
+uniform float time;
+uniform float gradient;
 
-    void main()
-    {
-        float gradientX = fragColor.x;
-        float gradientY = fragColor.y;
+out vec4 finalColor;
 
-        finalColor = vec4(gradientX, gradientY, 1.0 - gradientX, 1.0); // Gradient from top-left (blue) to bottom-right
-  (yellow)
-    }
+// Same conversion as raylib's ColorFromHSV.
+vec3 hsv2rgb(float hue, float saturation, float value)
+{
+    vec3 k = mod(vec3(5.0, 3.0, 1.0) + hue / 60.0, 6.0);
+    k = clamp(min(k, 4.0 - k), 0.0, 1.0);
+    return value - value * saturation * k;
+}
+
+void main()
+{
+    vec2 p = fragTexCoord * size;
+    // Bars are barWidth wide and separated by a gap of the same width.
+    float slot = p.x / (2.0 * barWidth);
+    float bar = floor(slot);
+    if (bar >= barCount || fract(slot) >= 0.5) discard;
+
+    float height = texture(texture0, vec2((bar + 0.5) / barCount, 0.5)).r;
+    float top = (size.y - height) / 2.0 - posYOffset;
+    if (p.y < top || p.y > top + height) discard;
+
+    float hue = hueStart + bar / barCount * hueRange + time * hueSpeed;
+    // 0 on the bar's centre line, 1 at its ends.
+    float edge = abs(p.y - top - height / 2.0) / max(height / 2.0, 1.0);
+    finalColor = vec4(hsv2rgb(hue, 1.0, 1.0 - gradient * edge), 1.0) * fragColor;
+}
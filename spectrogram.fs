@@ -0,0 +1,28 @@
+#version 330
+
+// Waterfall: texture0 is a ring of spectrum rows (one R32 texel per band,
+// normalised amplitude). Only the newest row is uploaded per analysis frame,
+// the scrolling is done here by offsetting into the ring.
+
+in vec2 fragTexCoord;
+in vec4 fragColor;
+
+uniform sampler2D texture0;
+// 256x1 colour map, indexed by level.
+uniform sampler2D lut;
+// One past the newest row, as a fraction of the ring height.
+uniform float offset;
+// Levels this far below the frame's peak map to the bottom of the LUT.
+uniform float dbRange;
+
+out vec4 finalColor;
+
+void main()
+{
+    // Newest row at the top, older rows scroll down.
+    float row = fract(offset - fragTexCoord.y);
+    float amplitude = texture(texture0, vec2(fragTexCoord.x, row)).r;
+    float db = 20.0 * log(max(amplitude, 1e-6)) / log(10.0);
+    float level = clamp(1.0 + db / dbRange, 0.0, 1.0);
+    finalColor = vec4(texture(lut, vec2(level, 0.5)).rgb, 1.0) * fragColor;
+}
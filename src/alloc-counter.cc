@@ -0,0 +1,86 @@
+#include "alloc-counter.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace audio {
+
+#ifdef AUDIO_VISUALIZER_ALLOC_CHECK
+namespace {
+thread_local uint64_t thread_allocations = 0;
+std::atomic<uint64_t> process_allocations{0};
+
+void countAllocation() {
+  thread_allocations++;
+  process_allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void *allocate(size_t size, size_t alignment) {
+  countAllocation();
+  size = size ? size : 1;
+  if (alignment <= alignof(std::max_align_t))
+    return std::malloc(size);
+  // aligned_alloc wants a multiple of the alignment.
+  return std::aligned_alloc(alignment,
+                            (size + alignment - 1) / alignment * alignment);
+}
+} // namespace
+
+uint64_t threadAllocationCount() { return thread_allocations; }
+uint64_t processAllocationCount() {
+  return process_allocations.load(std::memory_order_relaxed);
+}
+
+void NoAllocScope::Check() const {
+  uint64_t allocations = threadAllocationCount() - start_;
+  if (allocations == 0)
+    return;
+  fprintf(stderr, "%s: %lu heap allocations in an allocation free section\n",
+          what_, allocations);
+  std::abort();
+}
+#else
+uint64_t threadAllocationCount() { return 0; }
+uint64_t processAllocationCount() { return 0; }
+#endif
+
+} // namespace audio
+
+#ifdef AUDIO_VISUALIZER_ALLOC_CHECK
+void *operator new(size_t size) {
+  if (void *ptr = audio::allocate(size, alignof(std::max_align_t)))
+    return ptr;
+  throw std::bad_alloc();
+}
+void *operator new[](size_t size) { return ::operator new(size); }
+void *operator new(size_t size, std::align_val_t alignment) {
+  if (void *ptr = audio::allocate(size, static_cast<size_t>(alignment)))
+    return ptr;
+  throw std::bad_alloc();
+}
+void *operator new[](size_t size, std::align_val_t alignment) {
+  return ::operator new(size, alignment);
+}
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  return audio::allocate(size, alignof(std::max_align_t));
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return audio::allocate(size, alignof(std::max_align_t));
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+
+namespace audio {
+
+// Heap allocations made so far by the calling thread and by the whole
+// process. Only counted in builds with AUDIO_VISUALIZER_ALLOC_CHECK, which
+// replace the global operator new; 0 otherwise.
+uint64_t threadAllocationCount();
+uint64_t processAllocationCount();
+
+// Aborts if the calling thread allocated between construction and
+// destruction while armed. Wrapped around code that must stay allocation
+// free once warmed up, e.g. a capture quantum. Compiles to nothing without
+// AUDIO_VISUALIZER_ALLOC_CHECK.
+class NoAllocScope {
+public:
+#ifdef AUDIO_VISUALIZER_ALLOC_CHECK
+  explicit NoAllocScope(const char *what, bool armed = true)
+      : what_(what), armed_(armed), start_(threadAllocationCount()) {}
+  ~NoAllocScope() {
+    if (armed_)
+      Check();
+  }
+
+private:
+  void Check() const;
+
+  const char *what_;
+  bool armed_;
+  uint64_t start_;
+#else
+  explicit NoAllocScope(const char *, bool = true) {}
+#endif
+
+public:
+  NoAllocScope(const NoAllocScope &) = delete;
+  NoAllocScope &operator=(const NoAllocScope &) = delete;
+};
+
+} // namespace audio
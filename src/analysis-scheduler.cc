@@ -0,0 +1,250 @@
+#include "analysis-scheduler.h"
+#include "analysis-worker.h"
+#include <algorithm>
+#include <cstdio>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace audio {
+
+AnalysisScheduler::SlotQueue::SlotQueue() {
+  for (size_t i = 0; i < cells_.size(); ++i)
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+// Dmitry Vyukov's bounded MPMC queue: a cell's sequence tells whether it is
+// free for the push at that position or holds the value for the pop.
+bool AnalysisScheduler::SlotQueue::Push(uint32_t slot) {
+  size_t pos = push_pos_.load(std::memory_order_relaxed);
+  for (;;) {
+    Cell &cell = cells_[pos % cells_.size()];
+    size_t sequence = cell.sequence.load(std::memory_order_acquire);
+    auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+    if (diff == 0) {
+      if (push_pos_.compare_exchange_weak(pos, pos + 1,
+                                          std::memory_order_relaxed)) {
+        cell.slot = slot;
+        cell.sequence.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = push_pos_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+bool AnalysisScheduler::SlotQueue::Pop(uint32_t &slot) {
+  size_t pos = pop_pos_.load(std::memory_order_relaxed);
+  for (;;) {
+    Cell &cell = cells_[pos % cells_.size()];
+    size_t sequence = cell.sequence.load(std::memory_order_acquire);
+    auto diff =
+        static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+    if (diff == 0) {
+      if (pop_pos_.compare_exchange_weak(pos, pos + 1,
+                                         std::memory_order_relaxed)) {
+        slot = cell.slot;
+        cell.sequence.store(pos + cells_.size(), std::memory_order_release);
+        return true;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = pop_pos_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+bool AnalysisScheduler::SlotQueue::Empty() const {
+  return push_pos_.load(std::memory_order_acquire) ==
+         pop_pos_.load(std::memory_order_acquire);
+}
+
+AnalysisScheduler::AnalysisScheduler(AnalysisSchedulerOptions options)
+    : options_(options) {
+  size_t count = options_.threads;
+  if (count == 0)
+    count = std::max<size_t>(std::thread::hardware_concurrency(), 2) - 1;
+  sources_per_thread_.assign(count, 0);
+  for (size_t i = 0; i < count; ++i)
+    threads_.push_back(std::make_unique<Thread>());
+  for (size_t i = 0; i < count; ++i)
+    threads_[i]->thread = std::thread(&AnalysisScheduler::Run, this, i);
+}
+
+AnalysisScheduler::~AnalysisScheduler() {
+  running_.store(false, std::memory_order_release);
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    threads_[i]->wakeups.fetch_add(1, std::memory_order_release);
+    threads_[i]->wakeups.notify_one();
+  }
+  for (auto &thread : threads_)
+    thread->thread.join();
+}
+
+AnalysisScheduler::Stats AnalysisScheduler::GetStats() const {
+  return {.runs = runs_.load(std::memory_order_relaxed),
+          .steals = steals_.load(std::memory_order_relaxed)};
+}
+
+int AnalysisScheduler::Add(AnalysisWorker *worker) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    Slot &slot = slots_[i];
+    if (slot.worker != nullptr ||
+        slot.state.load(std::memory_order_acquire) != kFree)
+      continue;
+    // The least busy thread becomes the source's home.
+    auto home = std::min_element(sources_per_thread_.begin(),
+                                 sources_per_thread_.end());
+    ++*home;
+    slot.worker = worker;
+    slot.home = home - sources_per_thread_.begin();
+    slot.state.store(kIdle, std::memory_order_release);
+    return static_cast<int>(i);
+  }
+  return -1;
+}
+
+void AnalysisScheduler::Remove(int index) {
+  Slot &slot = slots_[index];
+  // Only an idle slot can be freed, a queued or running one is waited for.
+  // The worker is stopped, so its run ends after the chunk in flight and
+  // RunSlot wakes us when it leaves the slot idle.
+  uint32_t state = slot.state.load(std::memory_order_acquire);
+  while (state != kIdle ||
+         !slot.state.compare_exchange_weak(state, kFree,
+                                           std::memory_order_acq_rel)) {
+    if (state != kIdle) {
+      slot.state.wait(state, std::memory_order_acquire);
+      state = slot.state.load(std::memory_order_acquire);
+    }
+  }
+  std::lock_guard<std::mutex> lock(mtx_);
+  --sources_per_thread_[slot.home];
+  slot.worker = nullptr;
+}
+
+void AnalysisScheduler::Notify(int index) {
+  Slot &slot = slots_[index];
+  uint32_t state = slot.state.load(std::memory_order_acquire);
+  for (;;) {
+    if (state == kIdle) {
+      if (slot.state.compare_exchange_weak(state, kQueued,
+                                           std::memory_order_acq_rel)) {
+        Enqueue(index);
+        return;
+      }
+    } else if (state == kRunning) {
+      // The running analysis may already be past the new input, have it
+      // requeue the source when done.
+      if (slot.state.compare_exchange_weak(state, kRunningDirty,
+                                           std::memory_order_acq_rel))
+        return;
+    } else {
+      // Queued, or already flagged, or removed.
+      return;
+    }
+  }
+}
+
+void AnalysisScheduler::Enqueue(uint32_t index) {
+  const size_t home = slots_[index].home;
+  threads_[home]->queue.Push(index);
+  Wake(home);
+}
+
+void AnalysisScheduler::Wake(size_t home) {
+  threads_[home]->wakeups.fetch_add(1, std::memory_order_release);
+  threads_[home]->wakeups.notify_one();
+  // Pairs with the fence in Run: either a sleeping thread is seen here, or it
+  // sees the queued source before it sleeps.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!threads_[home]->sleeping.load(std::memory_order_relaxed)) {
+    // Home is busy, let an idle thread steal the source meanwhile.
+    for (size_t i = 0; i < threads_.size(); ++i) {
+      if (i != home && threads_[i]->sleeping.load(std::memory_order_relaxed)) {
+        threads_[i]->wakeups.fetch_add(1, std::memory_order_release);
+        threads_[i]->wakeups.notify_one();
+        break;
+      }
+    }
+  }
+}
+
+bool AnalysisScheduler::Take(size_t self, uint32_t &index) {
+  if (threads_[self]->queue.Pop(index))
+    return true;
+  for (size_t i = 1; i < threads_.size(); ++i) {
+    if (threads_[(self + i) % threads_.size()]->queue.Pop(index)) {
+      steals_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+void AnalysisScheduler::RunSlot(uint32_t index) {
+  Slot &slot = slots_[index];
+  // Queued slots belong to whoever popped them, no Notify changes the state.
+  slot.state.store(kRunning, std::memory_order_relaxed);
+  runs_.fetch_add(1, std::memory_order_relaxed);
+  const bool more = slot.worker->RunScheduled();
+  uint32_t expected = kRunning;
+  if (!more && slot.state.compare_exchange_strong(expected, kIdle,
+                                                  std::memory_order_acq_rel)) {
+    // For Remove, a no-op unless someone waits.
+    slot.state.notify_all();
+    return;
+  }
+  // Input left over or pushed while running: to the back of the home queue,
+  // behind the other sources.
+  slot.state.store(kQueued, std::memory_order_release);
+  Enqueue(index);
+}
+
+void AnalysisScheduler::Run(size_t self) {
+  ApplyThreadOptions(self);
+  Thread &thread = *threads_[self];
+  while (running_.load(std::memory_order_acquire)) {
+    const uint32_t seen = thread.wakeups.load(std::memory_order_acquire);
+    uint32_t index;
+    if (Take(self, index)) {
+      RunSlot(index);
+      continue;
+    }
+    thread.sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const bool any_queued = std::any_of(
+        threads_.begin(), threads_.end(),
+        [](const std::unique_ptr<Thread> &t) { return !t->queue.Empty(); });
+    if (!any_queued)
+      thread.wakeups.wait(seen, std::memory_order_acquire);
+    thread.sleeping.store(false, std::memory_order_relaxed);
+  }
+}
+
+void AnalysisScheduler::ApplyThreadOptions(size_t self) {
+  std::string name = "analysis-" + std::to_string(self);
+  pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+
+  if (options_.nice != 0 &&
+      setpriority(PRIO_PROCESS, gettid(), options_.nice) != 0)
+    perror("analysis scheduler: setpriority");
+
+  if (options_.pin_threads) {
+    const unsigned cpus = std::max(std::thread::hardware_concurrency(), 1u);
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(self % cpus, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+      fprintf(stderr, "analysis scheduler: cannot pin thread %zu\n", self);
+  }
+}
+
+} // namespace audio
@@ -0,0 +1,114 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace audio {
+
+class AnalysisWorker;
+
+struct AnalysisSchedulerOptions {
+  // 0 is one per core, less one for the render thread.
+  size_t threads = 0;
+  // Pin pool thread i to cpu i (modulo the cpu count).
+  bool pin_threads = false;
+  // Applied to the pool threads.
+  int nice = 0;
+};
+
+// Runs the analysis of any number of sources on a fixed pool of threads, in
+// place of a thread per AnalysisWorker. A Push into a worker's ring marks the
+// source runnable and queues it, once, on its home thread. Sources are spread
+// over the threads and stay on their home thread so their Stft and FFT scratch
+// remain in that core's cache. A thread whose queue runs dry steals from the
+// others before going to sleep. A source is only ever run by one thread at a
+// time, a run drains a few hops and requeues the source if input is left.
+class AnalysisScheduler {
+public:
+  static constexpr size_t kMaxSources = 256;
+
+  struct Stats {
+    uint64_t runs;
+    uint64_t steals;
+  };
+
+  explicit AnalysisScheduler(
+      AnalysisSchedulerOptions options = AnalysisSchedulerOptions{});
+  ~AnalysisScheduler();
+
+  AnalysisScheduler(const AnalysisScheduler &) = delete;
+  AnalysisScheduler &operator=(const AnalysisScheduler &) = delete;
+
+  size_t ThreadCount() const { return threads_.size(); }
+  Stats GetStats() const;
+
+  // Used by AnalysisWorker. Add returns the source's slot, -1 when all
+  // kMaxSources are taken. Remove blocks until a queued or running analysis
+  // of the source has finished, which for a stopped worker is at most one
+  // hop; its producer must have stopped pushing.
+  int Add(AnalysisWorker *worker);
+  void Remove(int slot);
+  // Real-time safe: no locks, no allocations.
+  void Notify(int slot);
+
+private:
+  enum State : uint32_t { kFree, kIdle, kQueued, kRunning, kRunningDirty };
+
+  struct Slot {
+    std::atomic<uint32_t> state{kFree};
+    AnalysisWorker *worker = nullptr;
+    size_t home = 0;
+  };
+
+  // Bounded multi-producer multi-consumer queue of slot indices. A slot is
+  // queued at most once across all threads, so it never fills up.
+  class SlotQueue {
+  public:
+    SlotQueue();
+    bool Push(uint32_t slot);
+    bool Pop(uint32_t &slot);
+    bool Empty() const;
+
+  private:
+    struct Cell {
+      std::atomic<size_t> sequence;
+      uint32_t slot;
+    };
+    std::array<Cell, kMaxSources> cells_;
+    alignas(64) std::atomic<size_t> push_pos_{0};
+    alignas(64) std::atomic<size_t> pop_pos_{0};
+  };
+
+  struct Thread {
+    SlotQueue queue;
+    std::atomic<uint32_t> wakeups{0};
+    std::atomic<bool> sleeping{false};
+    std::thread thread;
+  };
+
+  void Run(size_t self);
+  bool Take(size_t self, uint32_t &slot);
+  void RunSlot(uint32_t slot);
+  void Enqueue(uint32_t slot);
+  void Wake(size_t thread);
+  void ApplyThreadOptions(size_t self);
+
+  AnalysisSchedulerOptions options_;
+  std::array<Slot, kMaxSources> slots_;
+  std::vector<std::unique_ptr<Thread>> threads_;
+  std::atomic<bool> running_{true};
+
+  // Guards slot assignment, never taken on the Notify path.
+  std::mutex mtx_;
+  std::vector<size_t> sources_per_thread_;
+
+  std::atomic<uint64_t> runs_{0};
+  std::atomic<uint64_t> steals_{0};
+};
+
+} // namespace audio
@@ -0,0 +1,195 @@
+#include "analysis-worker.h"
+#include "alloc-counter.h"
+#include "analysis-scheduler.h"
+#include "simd-kernels.h"
+#include <algorithm>
+#include <cstdio>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <utility>
+
+namespace audio {
+
+AnalysisWorker::AnalysisWorker(std::string name, StftOptions stft,
+                               size_t ring_capacity, FrameCallback callback,
+                               AnalysisWorkerOptions options)
+    : name_(std::move(name)), stft_options_(stft), stft_(stft),
+      callback_(std::move(callback)), options_(options),
+      ring_(ring_capacity), marks_(256) {}
+
+AnalysisWorker::~AnalysisWorker() { Stop(); }
+
+void AnalysisWorker::Start() {
+  if (running_.exchange(true))
+    return;
+  if (options_.scheduler != nullptr) {
+    Reconfigure(pushed_channels_.load(std::memory_order_relaxed));
+    int slot = options_.scheduler->Add(this);
+    if (slot >= 0) {
+      slot_.store(slot, std::memory_order_release);
+      return;
+    }
+    fprintf(stderr, "analysis worker: scheduler full, %s gets its own thread\n",
+            name_.c_str());
+  }
+  thread_ = std::thread(&AnalysisWorker::Run, this);
+}
+
+void AnalysisWorker::Stop() {
+  if (!running_.exchange(false))
+    return;
+  int slot = slot_.exchange(-1, std::memory_order_acq_rel);
+  if (slot >= 0) {
+    options_.scheduler->Remove(slot);
+    return;
+  }
+  wakeups_.fetch_add(1, std::memory_order_release);
+  wakeups_.notify_one();
+  thread_.join();
+}
+
+void AnalysisWorker::Push(const float *interleaved, size_t frames,
+                          size_t channels, int64_t capture_ns) {
+  pushed_channels_.store(channels, std::memory_order_relaxed);
+  // Whole frames only, so the consumer never sees a torn frame.
+  size_t writable = std::min(frames, ring_.WriteAvailable() / channels);
+  ring_.Write(interleaved, writable * channels);
+  frames_written_ += writable;
+  if (capture_ns != 0 && writable > 0) {
+    CaptureMark mark{frames_written_, capture_ns};
+    marks_.Write(&mark, 1);
+  }
+  pushed_samples_.fetch_add(writable, std::memory_order_relaxed);
+  if (writable < frames) {
+    dropped_samples_.fetch_add(frames - writable, std::memory_order_relaxed);
+    overruns_.fetch_add(1, std::memory_order_relaxed);
+  }
+  int slot = slot_.load(std::memory_order_acquire);
+  if (slot >= 0) {
+    options_.scheduler->Notify(slot);
+    return;
+  }
+  // Futex wake, never takes a lock on the producer side.
+  wakeups_.fetch_add(1, std::memory_order_release);
+  wakeups_.notify_one();
+}
+
+AnalysisWorker::Stats AnalysisWorker::GetStats() const {
+  return {.pushed_samples = pushed_samples_.load(std::memory_order_relaxed),
+          .dropped_samples = dropped_samples_.load(std::memory_order_relaxed),
+          .overruns = overruns_.load(std::memory_order_relaxed),
+          .processed_frames =
+              processed_frames_.load(std::memory_order_relaxed),
+          .stale_samples = stale_samples_.load(std::memory_order_relaxed)};
+}
+
+void AnalysisWorker::Run() {
+  ApplyThreadOptions();
+  Reconfigure(pushed_channels_.load(std::memory_order_relaxed));
+
+  while (running_.load(std::memory_order_acquire)) {
+    // Sampled before draining so a Push racing with the Read below still
+    // wakes us up.
+    uint32_t seen = wakeups_.load(std::memory_order_acquire);
+    if (!ProcessChunk())
+      wakeups_.wait(seen, std::memory_order_acquire);
+  }
+}
+
+bool AnalysisWorker::RunScheduled() {
+  for (size_t i = 0; i < kHopsPerRun; ++i) {
+    // Stop waits for the run to end, don't make it wait for the backlog.
+    if (!running_.load(std::memory_order_acquire) || !ProcessChunk())
+      return false;
+  }
+  return ring_.ReadAvailable() >= channels_;
+}
+
+bool AnalysisWorker::ProcessChunk() {
+  size_t channels = pushed_channels_.load(std::memory_order_relaxed);
+  if (channels != channels_)
+    Reconfigure(channels);
+  DropStale();
+
+  size_t available = std::min(ring_.ReadAvailable(), chunk_.size());
+  size_t read = ring_.Read(chunk_.data(), available - available % channels_);
+  if (read == 0)
+    return false;
+  size_t frames = read / channels_;
+  NoAllocScope no_alloc(name_.c_str(),
+                        frames_since_reconfigure_ >= kWarmupFrames);
+  deinterleave(chunk_.data(), frames, channels_, planar_rows_.data());
+  const uint64_t chunk_start = frames_read_;
+  const uint64_t stft_start = stft_.SamplesPushed();
+  frames_read_ += frames;
+  // Channels past kMaxAnalysedChannels are deinterleaved but not analysed.
+  stft_.Push(planar_rows_.data(), frames, [&](const StftFrame &frame) {
+    StftFrame timed = frame;
+    timed.capture_ns =
+        CaptureTimeOf(chunk_start + stft_.SamplesPushed() - stft_start);
+    callback_(timed);
+    frames_since_reconfigure_++;
+    processed_frames_.fetch_add(1, std::memory_order_relaxed);
+  });
+  return true;
+}
+
+void AnalysisWorker::DropStale() {
+  if (options_.max_backlog_hops == 0)
+    return;
+  const size_t backlog = ring_.ReadAvailable() / channels_;
+  const size_t window = stft_.WindowSize();
+  if (backlog <= window + options_.max_backlog_hops * stft_.HopSize())
+    return;
+  // What is left is one window of fresh input, the next frame is made of it
+  // alone and tells the consumers it does not follow on from the last one.
+  const size_t stale = backlog - window;
+  ring_.Skip(stale * channels_);
+  frames_read_ += stale;
+  stft_.Restart();
+  stale_samples_.fetch_add(stale, std::memory_order_relaxed);
+}
+
+int64_t AnalysisWorker::CaptureTimeOf(uint64_t frame_index) {
+  // Marks arrive in order, skip to the first one at or past frame_index.
+  while (mark_.end_frame < frame_index && marks_.ReadAvailable() > 0)
+    marks_.Read(&mark_, 1);
+  if (mark_.capture_ns == 0)
+    return 0;
+  int64_t frames_before_mark = int64_t(mark_.end_frame) - int64_t(frame_index);
+  return mark_.capture_ns -
+         frames_before_mark * 1000000000 /
+             int64_t(sample_rate_.load(std::memory_order_relaxed));
+}
+
+void AnalysisWorker::Reconfigure(size_t channels) {
+  channels_ = std::max<size_t>(channels, 1);
+  frames_since_reconfigure_ = 0;
+  stft_ = Stft(stft_options_, std::min(channels_, kMaxAnalysedChannels));
+  chunk_.assign(stft_.HopSize() * channels_, 0.0f);
+  planar_.assign(channels_, std::vector<float>(stft_.HopSize()));
+  planar_rows_.resize(channels_);
+  for (size_t c = 0; c < channels_; ++c)
+    planar_rows_[c] = planar_[c].data();
+}
+
+void AnalysisWorker::ApplyThreadOptions() {
+  pthread_setname_np(pthread_self(), name_.substr(0, 15).c_str());
+
+  if (options_.nice != 0 &&
+      setpriority(PRIO_PROCESS, gettid(), options_.nice) != 0)
+    perror("analysis worker: setpriority");
+
+  if (options_.cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(options_.cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+      fprintf(stderr, "analysis worker: cannot pin %s to cpu %d\n",
+              name_.c_str(), options_.cpu);
+  }
+}
+
+} // namespace audio
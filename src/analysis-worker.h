@@ -0,0 +1,133 @@
+#pragma once
+#include "processed-audio.h"
+#include "spsc-ring.h"
+#include "stft.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace audio {
+
+class AnalysisScheduler;
+
+struct AnalysisWorkerOptions {
+  // Applied to the worker thread only, the capture thread is untouched.
+  int nice = 0;
+  // Pin the worker to this cpu, -1 leaves the affinity alone.
+  int cpu = -1;
+  // Analyse on this shared pool instead of a thread of our own, nice and cpu
+  // are then the scheduler's. Must outlive the worker.
+  AnalysisScheduler *scheduler = nullptr;
+  // When more than a window plus this many hops wait in the ring, the oldest
+  // input is dropped down to one window, so a source that fell behind shows
+  // the present instead of catching up on the past. The first frame after a
+  // drop is flagged as a discontinuity. 0 never drops.
+  size_t max_backlog_hops = 0;
+};
+
+// Decouples analysis from the capture thread. Push copies interleaved samples
+// into a wait-free ring and returns, a dedicated thread drains the ring,
+// deinterleaves it and runs it through an Stft, handing every window_size
+// frame, one per hop, to the callback. At most kMaxAnalysedChannels channels
+// are analysed. With a scheduler in the options the draining runs on its
+// pool instead, see analysis-scheduler.h.
+class AnalysisWorker {
+public:
+  using FrameCallback = std::function<void(const StftFrame &)>;
+
+  // Frames analysed after a (re)configuration before the analysis is
+  // expected to run allocation free: one per triple buffer slot, plus one.
+  static constexpr uint64_t kWarmupFrames = 4;
+
+  struct Stats {
+    uint64_t pushed_samples;
+    uint64_t dropped_samples;
+    uint64_t overruns;
+    uint64_t processed_frames;
+    // Dropped by the analysis as stale, see max_backlog_hops.
+    uint64_t stale_samples;
+  };
+
+  AnalysisWorker(std::string name, StftOptions stft, size_t ring_capacity,
+                 FrameCallback callback,
+                 AnalysisWorkerOptions options = AnalysisWorkerOptions{});
+  ~AnalysisWorker();
+
+  void Start();
+  void Stop();
+
+  // Real-time safe: no locks, no allocations. Frames that do not fit in the
+  // ring are dropped and counted as an overrun. A change of channel count
+  // restarts the analysis history. capture_ns is the CLOCK_MONOTONIC capture
+  // time of the last frame, 0 if unknown, and is carried to the StftFrames.
+  void Push(const float *interleaved, size_t frames, size_t channels,
+            int64_t capture_ns = 0);
+
+  // Used to turn capture times of earlier samples into timestamps.
+  void SetSampleRate(size_t sample_rate) {
+    sample_rate_.store(sample_rate, std::memory_order_relaxed);
+  }
+
+  Stats GetStats() const;
+
+private:
+  // Capture time of the sample just before index end_frame.
+  struct CaptureMark {
+    uint64_t end_frame;
+    int64_t capture_ns;
+  };
+
+  friend class AnalysisScheduler;
+
+  // Hops drained per scheduled run before the source goes to the back of the
+  // queue, so one busy source cannot starve the others.
+  static constexpr size_t kHopsPerRun = 8;
+
+  int64_t CaptureTimeOf(uint64_t frame_index);
+  void Run();
+  // Analyses up to one hop from the ring, false if there was nothing to read.
+  bool ProcessChunk();
+  // Called by the scheduler, true if input is left in the ring.
+  bool RunScheduled();
+  void DropStale();
+  void ApplyThreadOptions();
+  void Reconfigure(size_t channels);
+
+  std::string name_;
+  StftOptions stft_options_;
+  Stft stft_;
+  // Worker side scratch, sized for one hop of interleaved input.
+  size_t channels_ = 1;
+  std::vector<float> chunk_;
+  std::vector<std::vector<float>> planar_;
+  std::vector<float *> planar_rows_;
+  FrameCallback callback_;
+  AnalysisWorkerOptions options_;
+  SpscRing<float> ring_;
+  SpscRing<CaptureMark> marks_;
+  uint64_t frames_written_ = 0;
+  // Worker side: frames drained from the ring and the last mark popped.
+  uint64_t frames_read_ = 0;
+  CaptureMark mark_{0, 0};
+  uint64_t frames_since_reconfigure_ = 0;
+  std::atomic<size_t> sample_rate_{48000};
+
+  std::thread thread_;
+  std::atomic<bool> running_{false};
+  // Scheduler slot while scheduled, -1 otherwise.
+  std::atomic<int> slot_{-1};
+  std::atomic<size_t> pushed_channels_{1};
+  std::atomic<uint32_t> wakeups_{0};
+
+  std::atomic<uint64_t> pushed_samples_{0};
+  std::atomic<uint64_t> dropped_samples_{0};
+  std::atomic<uint64_t> overruns_{0};
+  std::atomic<uint64_t> processed_frames_{0};
+  std::atomic<uint64_t> stale_samples_{0};
+};
+
+} // namespace audio
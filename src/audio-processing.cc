@@ -1,98 +1,239 @@
 #include "audio-processing.h"
+#include "fft-plan-cache.h"
+#include "frequency-table.h"
+#include "simd-kernels.h"
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
 #include <fftw3.h>
+#include <map>
 #include <mutex>
+#include <shared_mutex>
 #include <vector>
 namespace audio {
-static std::mutex fftw_mtx;
+namespace {
+// Per thread scratch so concurrent streams never share FFT buffers. Grown on
+// demand, so after the first call for a given size nothing is allocated.
+struct FftScratch {
+  size_t capacity = 0;
+  FftwfBuffer<float> in;
+  FftwfBuffer<fftwf_complex> out;
+
+  // rows transforms of sample_count samples, back to back.
+  void Reserve(size_t sample_count, size_t rows = 1) {
+    size_t needed = (sample_count / 2 + 1) * 2 * rows;
+    if (needed <= capacity)
+      return;
+    in = allocFftwfReal(needed);
+    out = allocFftwfComplex(needed / 2);
+    capacity = needed;
+  }
+};
+thread_local FftScratch scratch;
 
-void computeFFT64(std::vector<float> &&samples, size_t sample_rate,
-                  ProcessedAudioBuffer &output, FftOptions options) {
+std::shared_mutex window_mtx;
+std::map<size_t, std::vector<float>> hann_windows;
+} // namespace
 
-  size_t sample_count = samples.size();
-  size_t out_size = sample_count / 2 + 1;
-  static std::vector<double> hanning_multipliers = [&]() {
-    std::vector<double> window(sample_count);
+const std::vector<float> &hannWindow(size_t size) {
+  {
+    std::shared_lock<std::shared_mutex> lock(window_mtx);
+    auto it = hann_windows.find(size);
+    if (it != hann_windows.end())
+      return it->second;
+  }
+  std::unique_lock<std::shared_mutex> lock(window_mtx);
+  auto [it, inserted] = hann_windows.try_emplace(size, size);
+  if (inserted) {
+    for (size_t i = 0; i < size; ++i)
+      it->second[i] = 0.5 * (1 - std::cos(2 * M_PI * i / (size - 1)));
+  }
+  return it->second;
+}
 
-    for (std::size_t i = 0; i < sample_count; ++i) {
-      window[i] = 0.5 * (1 - std::cos(2 * M_PI * i / (sample_count - 1)));
-    }
-    return window;
-  }();
+namespace {
+// Maps are cached process wide, remember the last one per thread so the
+// steady state does not even take the cache's shared lock.
+const BandMap &bandMapFor(size_t sample_count, size_t sample_rate,
+                          const FftOptions &options) {
+  thread_local const BandMap *last = nullptr;
+  BandMapKey key{.fft_size = sample_count,
+                 .sample_rate = sample_rate,
+                 .scale = options.band_scale,
+                 .band_count = options.band_count,
+                 .max_frequency = static_cast<float>(options.max_frequency),
+                 .reduction = options.band_reduction};
+  if (last == nullptr || last->Key() != key)
+    last = &BandMap::Get(key);
+  return *last;
+}
 
-  fftw_complex in[sample_count], out[sample_count];
+// Normalised magnitudes of one r2c output row into output.magnitudes, which
+// holds sample_count / 2 + 1 bins.
+void fillMagnitudes(const fftwf_complex *out, size_t sample_count,
+                    size_t sample_rate, size_t max_frequency,
+                    ProcessedAudioBuffer &output) {
+  size_t out_size = sample_count / 2 + 1;
 
-  const int maxFrequency = options.max_frequency;
+  const int maxFrequency = max_frequency;
 
   double freqResolution =
       float(sample_rate) / sample_count; // Frequency resolution
                                          //
   size_t maxIndex = static_cast<size_t>(maxFrequency / freqResolution);
 
-  fftw_plan p;
+  const Kernels &k = kernels();
+  size_t count = std::min(maxIndex + 1, out_size);
+  float *magnitudes = output.magnitudes.data();
 
-  // Initialize input array
-  for (int i = 0; i < sample_count; ++i) {
-    in[i][0] = static_cast<double>(samples.at(i)) *
-               hanning_multipliers[i]; // Real Part
-    in[i][1] = 0.0;                    // Imaginary part
-  }
+  k.complex_magnitude(&out[0][0], magnitudes, count);
+  std::fill(magnitudes + count, magnitudes + out_size, 0.0f);
+  MaxSum reduced = k.max_sum(magnitudes, count);
 
-  // Create plan for FFT
-  {
-    std::lock_guard<std::mutex> fftw_guard(fftw_mtx);
-    p = fftw_plan_dft_1d(sample_count, in, out, FFTW_FORWARD, FFTW_ESTIMATE);
-  }
+  output.max_amplitude = reduced.max;
+  output.avg_amplitude = reduced.sum / std::min(maxIndex, out_size);
 
-  // Execute FFT
-  fftw_execute(p);
-
-  float max_amplitude = 0;
-  float sum = 0;
-
-  for (int i = 0; i <= maxIndex && i < out_size; i++) {
-    output.samples[i].sine_component = out[i][0];
-    output.samples[i].cosine_component = out[i][1];
-    output.samples[i].frequency =
-        static_cast<float>(i) * sample_rate / sample_count;
-    float amplitude =
-        (std::sqrt(out[i][0] * out[i][0] + out[i][1] * out[i][1]));
-    max_amplitude = std::max(max_amplitude, amplitude);
-    sum += amplitude;
-    output.samples[i].normalized_amplitude = amplitude;
-  }
+  // Silent rows (e.g. side of a mono source) stay at zero instead of NaN.
+  k.scale(magnitudes, count,
+          reduced.max > 0.0f ? 1.0f / reduced.max : 0.0f);
 
-  output.max_amplitude = max_amplitude;
-  output.avg_amplitude = sum / std::min(maxIndex, out_size);
-
-  for (int i = 0; i <= maxIndex && i < out_size; i++) {
-    output.samples[i].normalized_amplitude /= max_amplitude;
-  }
+  output.frequencies = linearFrequencyTable(sample_count, sample_rate);
+}
 
-  float step = 1.06;
-  float lowf = 1.0f;
-  size_t m = 0;
-  float max_amp = 1.0f;
-
-  for (float f = lowf; (size_t)f < out_size / 2; f = std::ceilf(f * step)) {
-    float f1 = std::ceilf(f * step);
-    float a = 0.0f;
-    float ff = 0.0f;
-    for (size_t q = (size_t)f; q < out_size / 2 && q < (size_t)f1; ++q) {
-      float b = output.samples[q].normalized_amplitude;
-      if (b > a) {
-        a = b;
-        ff = output.samples[q].frequency;
-      }
+// Magnitudes, normalisation and band squashing of one r2c output row.
+void fillProcessedBuffer(const fftwf_complex *out, size_t sample_count,
+                         size_t sample_rate, ProcessedAudioBuffer &output,
+                         FftOptions options) {
+  const size_t out_size = sample_count / 2 + 1;
+  output.magnitudes.resize(out_size);
+  fillMagnitudes(out, sample_count, sample_rate, options.max_frequency,
+                 output);
+
+  if (options.keep_complex) {
+    output.re.resize(out_size);
+    output.im.resize(out_size);
+    for (size_t i = 0; i < out_size; ++i) {
+      output.re[i] = out[i][0];
+      output.im[i] = out[i][1];
     }
-    output.squashed_samples[m++] = {.normalized_amplitude = a, .frequency = ff};
+  } else {
+    output.re.clear();
+    output.im.clear();
   }
 
-  {
-    std::lock_guard<std::mutex> fftw_guard(fftw_mtx);
-    fftw_destroy_plan(p);
-    fftw_cleanup();
+  const BandMap &band_map = bandMapFor(sample_count, sample_rate, options);
+  output.band_amplitudes.resize(band_map.size());
+  output.band_frequencies.resize(band_map.size());
+  band_map.Reduce(output.magnitudes.data(), output.band_amplitudes.data(),
+                  output.band_frequencies.data());
+}
+} // namespace
+
+void computeFFT64(std::span<const float> samples, size_t sample_rate,
+                  ProcessedAudioBuffer &output, FftOptions options) {
+
+  size_t sample_count = samples.size();
+  const std::vector<float> &hanning_multipliers = hannWindow(sample_count);
+
+  scratch.Reserve(sample_count);
+  float *in = scratch.in.get();
+  fftwf_complex *out = scratch.out.get();
+
+  // Real input only: r2c skips the redundant half.
+  kernels().window_multiply(samples.data(), hanning_multipliers.data(), in,
+                            sample_count);
+
+  // Planned once per size, executing a cached plan is thread safe.
+  fftwf_execute_dft_r2c(FftPlanCache::Instance().RealToComplexF(sample_count),
+                        in, out);
+
+  fillProcessedBuffer(out, sample_count, sample_rate, output, options);
+}
+
+namespace {
+// The batched analysis behind both multichannel entry points. A non-zero
+// kSize or kChannels fixes that dimension at compile time, the frame must
+// then match it.
+template <size_t kSize, size_t kChannels>
+void analyseBatch(const StftFrame &frame, size_t sample_rate,
+                  ProcessedAudioFrame &output, const FftOptions &options,
+                  const float *window, fftwf_plan plan) {
+  const size_t n = kSize != 0 ? kSize : frame.size;
+  const size_t out_size = n / 2 + 1;
+  const size_t channels =
+      kChannels != 0 ? kChannels
+                     : std::min(frame.channel_count, kMaxAnalysedChannels);
+  // Channel rows followed by mid and side.
+  const size_t rows = channels + 2;
+
+  scratch.Reserve(n, rows);
+  float *in = scratch.in.get();
+  fftwf_complex *out = scratch.out.get();
+  float *mid = in + channels * n;
+  float *side = in + (channels + 1) * n;
+
+  const Kernels &k = kernels();
+  for (size_t c = 0; c < channels; ++c)
+    k.window_multiply(frame.channels[c], window, in + c * n, n);
+
+  // The window is linear, so mid and side can be built from windowed rows.
+  const float mid_scale = 1.0f / channels;
+  for (size_t i = 0; i < n; ++i) {
+    float acc = 0.0f;
+    for (size_t c = 0; c < channels; ++c)
+      acc += in[c * n + i];
+    mid[i] = acc * mid_scale;
+  }
+  if (channels >= 2) {
+    for (size_t i = 0; i < n; ++i)
+      side[i] = (in[i] - in[n + i]) * 0.5f;
+  } else {
+    std::fill(side, side + n, 0.0f);
   }
+
+  fftwf_execute_dft_r2c(plan, in, out);
+
+  output.channel_count = channels;
+  for (size_t c = 0; c < channels; ++c)
+    fillProcessedBuffer(out + c * out_size, n, sample_rate,
+                        output.channels[c], options);
+  fillProcessedBuffer(out + channels * out_size, n, sample_rate, output.mid,
+                      options);
+  fillProcessedBuffer(out + (channels + 1) * out_size, n, sample_rate,
+                      output.side, options);
 }
+} // namespace
+
+void computeFFTMultichannel(const StftFrame &frame, size_t sample_rate,
+                            ProcessedAudioFrame &output, FftOptions options) {
+  const size_t n = frame.size;
+  const size_t rows = std::min(frame.channel_count, kMaxAnalysedChannels) + 2;
+  analyseBatch<0, 0>(frame, sample_rate, output, options,
+                     hannWindow(n).data(),
+                     FftPlanCache::Instance().RealToComplexF(n, rows));
+}
+
+template <size_t fft_size, size_t channels>
+void computeFFTMultichannelFixed(const StftFrame &frame, size_t sample_rate,
+                                 ProcessedAudioFrame &output,
+                                 FftOptions options) {
+  // Looked up once per instantiation instead of per call.
+  static const float *window = hannWindow(fft_size).data();
+  static const fftwf_plan plan =
+      FftPlanCache::Instance().RealToComplexF(fft_size, channels + 2);
+  analyseBatch<fft_size, channels>(frame, sample_rate, output, options,
+                                   window, plan);
+}
+
+#define AUDIO_INSTANTIATE_FIXED_FFT(size)                                      \
+  template void computeFFTMultichannelFixed<size, 1>(                          \
+      const StftFrame &, size_t, ProcessedAudioFrame &, FftOptions);           \
+  template void computeFFTMultichannelFixed<size, 2>(                          \
+      const StftFrame &, size_t, ProcessedAudioFrame &, FftOptions);
+AUDIO_INSTANTIATE_FIXED_FFT(1024)
+AUDIO_INSTANTIATE_FIXED_FFT(2048)
+AUDIO_INSTANTIATE_FIXED_FFT(4096)
+AUDIO_INSTANTIATE_FIXED_FFT(8192)
+#undef AUDIO_INSTANTIATE_FIXED_FFT
 
 } // namespace audio
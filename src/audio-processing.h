@@ -1,15 +1,52 @@
 #pragma once
+#include "band-map.h"
 #include "processed-audio.h"
+#include "stft.h"
 #include <cstddef>
+#include <span>
 #include <vector>
 
 namespace audio {
 
 struct FftOptions {
   size_t max_frequency = 30000;
+  // How bins are grouped into band_amplitudes, see BandMap.
+  BandScale band_scale = BandScale::kGeometric;
+  size_t band_count = 64;
+  BandReduction band_reduction = BandReduction::kPeak;
+  // Also store the complex bins (ProcessedAudioBuffer::re/im). Nothing on
+  // screen needs them, so they cost nothing unless asked for.
+  bool keep_complex = false;
+  // Octaves analysed by MultiResolutionAnalyzer, 1 is a single full-band FFT
+  // of the window. Only honoured by AudioProcessor.
+  size_t resolution_levels = 1;
 };
 
-void computeFFT64(std::vector<float> &&samples, size_t sample_rate,
+// Hann window of the given size, built once per size and shared by all
+// threads. The reference stays valid for the lifetime of the process.
+const std::vector<float> &hannWindow(size_t size);
+
+// Spectrum of one window of mono samples, samples is only read.
+void computeFFT64(std::span<const float> samples, size_t sample_rate,
                   ProcessedAudioBuffer &output,
                   FftOptions options = FftOptions{});
+
+// Spectra of every channel of the frame plus its mid and side signals,
+// computed with a single batched FFTW plan.
+void computeFFTMultichannel(const StftFrame &frame, size_t sample_rate,
+                            ProcessedAudioFrame &output,
+                            FftOptions options = FftOptions{});
+
+// computeFFTMultichannel for a window size and analysed channel count known
+// at compile time, with the same output. The window and batched plan are
+// looked up once, and the per-row loops have constant trip counts.
+// Instantiated for kFixedFftSizes x kFixedChannelCounts, makeSpectrumAnalyzer
+// picks it at runtime.
+template <size_t fft_size, size_t channels>
+void computeFFTMultichannelFixed(const StftFrame &frame, size_t sample_rate,
+                                 ProcessedAudioFrame &output,
+                                 FftOptions options = FftOptions{});
+
+inline constexpr size_t kFixedFftSizes[] = {1024, 2048, 4096, 8192};
+inline constexpr size_t kFixedChannelCounts[] = {1, 2};
 } // namespace audio
@@ -1,8 +1,17 @@
 #pragma once
 #include "audio-processing.h"
+#include "beat-tracker.h"
+#include "clock.h"
+#include "loudness-meter.h"
+#include "multi-resolution.h"
 #include "processed-audio.h"
+#include "shared-spectrum.h"
+#include "spectrum-analyzer.h"
+#include "stft.h"
+#include "triple-buffer.h"
+#include <algorithm>
 #include <cstddef>
-#include <mutex>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -12,49 +21,71 @@ namespace audio {
 class AudioProcessor {
 public:
   AudioProcessor(std::string_view source, size_t sample_rate,
-                 size_t sample_count)
-      : source_(source), sample_rate_(sample_rate),
-        front_buffer_(sample_count / 2 + 1), back_buffer_(sample_count / 2 + 1),
-        current_buffer_(front_buffer_) {}
+                 size_t sample_count, FftOptions options = FftOptions{})
+      : source_(source), sample_rate_(sample_rate), options_(options),
+        multi_resolution_(options.resolution_levels),
+        buffers_(MultiResolutionAnalyzer::BinCount(
+            sample_count, options.resolution_levels)) {}
 
 private:
-  ProcessedAudioBuffer &AlternateBuffer() {
-    if (is_front_buffer_active_)
-      return back_buffer_;
-    return front_buffer_;
-  }
-
-  void ProcessAudioSamplesIntoBackBuffer(std::vector<float> &&sample) {
-    computeFFT64(std::move(sample), sample_rate_, AlternateBuffer());
-  }
-
-  void SwitchBuffers() {
-    std::lock_guard<std::mutex> lock(buffer_lock_);
-    if (is_front_buffer_active_) {
-      current_buffer_ = back_buffer_;
-    } else {
-      current_buffer_ = front_buffer_;
+  void ProcessAudioSamplesIntoBackBuffer(const StftFrame &frame) {
+    if (options_.resolution_levels > 1) {
+      multi_resolution_.Process(frame, sample_rate_, buffers_.WriteBuffer(),
+                                options_);
+      return;
     }
-    is_front_buffer_active_ = !is_front_buffer_active_;
+    // Picked again when the source's channel count changes, which restarts
+    // the analysis anyway.
+    const size_t channels =
+        std::min(frame.channel_count, kMaxAnalysedChannels);
+    if (!analyzer_ || analyzer_->WindowSize() != frame.size ||
+        analyzer_->Channels() != channels)
+      analyzer_ = makeSpectrumAnalyzer(frame.size, channels, options_);
+    analyzer_->Analyze(frame, sample_rate_, buffers_.WriteBuffer());
   }
 
 public:
-  void OnNewSample(std::vector<float> &&sample) {
-    ProcessAudioSamplesIntoBackBuffer(std::move(sample));
-    SwitchBuffers();
+  // Also copy every frame to shared memory for other processes, see
+  // SharedSpectrumWriter. Set before the source starts.
+  void PublishTo(std::unique_ptr<SharedSpectrumWriter> writer) {
+    shared_ = std::move(writer);
   }
-  const ProcessedAudioBuffer &Buffer() {
-    std::lock_guard<std::mutex> lock(buffer_lock_);
-    return current_buffer_;
+
+  // Producer side, called from the analysis thread.
+  void OnNewSample(const StftFrame &frame) {
+    FrameTiming &timing = buffers_.WriteBuffer().timing;
+    timing.capture_ns = frame.capture_ns;
+    timing.fft_start_ns = monotonicNs();
+    if (frame.discontinuity) {
+      // Input was dropped before this frame, neither tracker may take the
+      // splice for music.
+      beat_tracker_.Restart();
+      loudness_meter_.Restart();
+    }
+    ProcessAudioSamplesIntoBackBuffer(frame);
+    ProcessedAudioFrame &back = buffers_.WriteBuffer();
+    size_t hop = frame.new_samples != 0 ? frame.new_samples : frame.size;
+    beat_tracker_.Process(back.mid, float(hop) / sample_rate_, back.beat);
+    loudness_meter_.Process(frame, sample_rate_, back.levels);
+    timing.fft_end_ns = monotonicNs();
+    timing.publish_ns = monotonicNs();
+    if (shared_)
+      shared_->Write(back, sample_rate_);
+    buffers_.Publish();
   }
+  // Consumer side, a single thread (the render loop). The returned frame is
+  // not written to until the next call to Buffer().
+  const ProcessedAudioFrame &Buffer() { return buffers_.Read(); }
 
 private:
   std::string source_;
   size_t sample_rate_;
-  std::mutex buffer_lock_;
-  bool is_front_buffer_active_;
-  ProcessedAudioBuffer front_buffer_;
-  ProcessedAudioBuffer back_buffer_;
-  ProcessedAudioBuffer &current_buffer_;
+  FftOptions options_;
+  MultiResolutionAnalyzer multi_resolution_;
+  std::unique_ptr<SpectrumAnalyzer> analyzer_;
+  BeatTracker beat_tracker_;
+  LoudnessMeter loudness_meter_;
+  std::unique_ptr<SharedSpectrumWriter> shared_;
+  TripleBuffer<ProcessedAudioFrame> buffers_;
 };
 } // namespace audio
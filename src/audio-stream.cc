@@ -1,10 +1,12 @@
 #include "audio-stream.h"
+#include "alloc-counter.h"
+#include "clock.h"
 #include "pipewire/pipewire.h"
 #include "pipewire/stream.h"
-#include "pipewire/thread-loop.h"
 #include "spa/param/audio/raw-utils.h"
 #include "spa/pod/builder.h"
 #include "spa/pod/pod.h"
+#include <array>
 #include <cstdint>
 #include <fftw3.h>
 #include <memory>
@@ -32,32 +34,54 @@ static const struct pw_stream_events stream_events = {
 } // namespace
 
 void AudioStream::Start() {
+  if (context_->stream == nullptr)
+    return;
 
-  size_t buffer[buffer_size_];
-  struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+  // Plenty for one EnumFormat pod.
+  std::array<uint8_t, 1024> buffer;
+  struct spa_pod_builder b =
+      SPA_POD_BUILDER_INIT(buffer.data(), sizeof(buffer));
 
   const struct spa_pod *params[1];
-  auto placeholder =
-      SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_F32,
-                              .rate = sample_rate_, .channels = 1);
+  // Channels left unset so the source's native layout is negotiated.
+  auto placeholder = SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_F32,
+                                             .rate = sample_rate_);
   params[0] =
       spa_format_audio_raw_build(&b, SPA_PARAM_EnumFormat, &placeholder);
+
+  worker_.Start();
+  // OnProcess only copies into the ring, so it can run directly on the
+  // shared real-time data loop.
+  PipewireSession::Lock lock(session_);
   pw_stream_connect(
       context_->stream, PW_DIRECTION_INPUT, PW_ID_ANY,
       static_cast<enum pw_stream_flags>(PW_STREAM_FLAG_AUTOCONNECT |
-                                        PW_STREAM_FLAG_MAP_BUFFERS),
+                                        PW_STREAM_FLAG_MAP_BUFFERS |
+                                        PW_STREAM_FLAG_RT_PROCESS),
       params, 1);
-
-  pw_thread_loop_start(context_->loop);
 }
 void AudioStream::Stop() {
-  pw_thread_loop_stop(context_->loop);
-  pw_stream_destroy(context_->stream);
-  pw_thread_loop_destroy(context_->loop);
-  pw_deinit();
+  if (context_->stream == nullptr)
+    return;
+  {
+    PipewireSession::Lock lock(session_);
+    spa_hook_remove(&context_->listener);
+    pw_stream_destroy(context_->stream);
+    context_->stream = nullptr;
+  }
+  worker_.Stop();
+
+  auto stats = worker_.GetStats();
+  fprintf(stdout,
+          "%s: analysed %lu frames, dropped %lu samples in %lu overruns, "
+          "%lu stale\n",
+          source_name_.c_str(), stats.processed_frames, stats.dropped_samples,
+          stats.overruns, stats.stale_samples);
 }
 
 void AudioStream::OnProcess() {
+  // Real-time thread: every quantum must get through without the allocator.
+  audio::NoAllocScope no_alloc("OnProcess");
 
   struct pw_buffer *b;
   struct spa_buffer *buf;
@@ -75,15 +99,22 @@ void AudioStream::OnProcess() {
 
   n_channels = context_->format.info.raw.channels;
   n_samples = buf->datas[0].chunk->size / sizeof(float);
-  // FFT
-  std::vector<float> samples_to_process;
-  samples_to_process.reserve(n_samples / n_channels);
-  for (int i = 0; i < n_samples; i += n_channels) {
-    samples_to_process.push_back(samples[i]);
-  }
+  // Only copy out here, deinterleaving and the FFT run on the analysis
+  // worker.
+  if (n_channels > 0)
+    worker_.Push(samples, n_samples / n_channels, n_channels, CaptureTime());
   pw_stream_queue_buffer(context_->stream, b);
-  freq_callback_(samples_to_process,
-                 context_->format.info.raw.rate / n_channels);
+}
+
+int64_t AudioStream::CaptureTime() const {
+  // now is the start of this graph cycle, delay the samples still queued
+  // between the device and us.
+  struct pw_time time;
+  if (pw_stream_get_time_n(context_->stream, &time, sizeof(time)) == 0 &&
+      time.now != 0 && time.rate.denom != 0)
+    return time.now -
+           time.delay * SPA_NSEC_PER_SEC * time.rate.num / time.rate.denom;
+  return audio::monotonicNs();
 }
 
 void AudioStream::OnStreamParamChanged(uint32_t id,
@@ -100,6 +131,9 @@ void AudioStream::OnStreamParamChanged(uint32_t id,
     return;
 
   spa_format_audio_raw_parse(param, &context_->format.info.raw);
+  captured_rate_.store(context_->format.info.raw.rate,
+                       std::memory_order_relaxed);
+  worker_.SetSampleRate(context_->format.info.raw.rate);
 
   fprintf(stdout, "capturing rate:%d channels:%d\n",
           context_->format.info.raw.rate, context_->format.info.raw.channels);
@@ -107,22 +141,25 @@ void AudioStream::OnStreamParamChanged(uint32_t id,
 
 std::unique_ptr<AudioStream::Context> AudioStream::CreateContext() {
   auto context = std::make_unique<Context>();
-  const struct spa_pod *params[1];
   struct pw_properties *props;
 
-  pw_init(nullptr, nullptr);
+  if (!session_.Connected())
+    return context;
 
-  auto thread_name = source_name_ + "_audio";
-  context->loop = pw_thread_loop_new(thread_name.data(), NULL);
-
-  props = pw_properties_new(PW_KEY_MEDIA_TYPE, "Audio", PW_KEY_CONFIG_NAME,
-                            "client-rt.conf", PW_KEY_MEDIA_CATEGORY, "Capture",
-                            PW_KEY_MEDIA_ROLE, "Music", NULL);
-  pw_properties_set(props, PW_KEY_TARGET_OBJECT, source_name_.data());
+  props = pw_properties_new(PW_KEY_MEDIA_TYPE, "Audio", PW_KEY_MEDIA_CATEGORY,
+                            "Capture", PW_KEY_MEDIA_ROLE, "Music", NULL);
+  if (target_object_.empty()) {
+    pw_properties_set(props, PW_KEY_TARGET_OBJECT, source_name_.data());
+  } else {
+    pw_properties_set(props, PW_KEY_TARGET_OBJECT, target_object_.data());
+    pw_properties_set(props, PW_KEY_NODE_DONT_RECONNECT, "true");
+  }
 
-  context->stream =
-      pw_stream_new_simple(pw_thread_loop_get_loop(context->loop),
-                           "chrome-audio-capture", props, &stream_events, this);
+  auto stream_name = source_name_ + "-audio-capture";
+  PipewireSession::Lock lock(session_);
+  context->stream = pw_stream_new(session_.Core(), stream_name.data(), props);
+  pw_stream_add_listener(context->stream, &context->listener, &stream_events,
+                         this);
   return context;
 }
-} // namespace Visualizer
+} // namespace Visualizer
\ No newline at end of file
@@ -1,6 +1,9 @@
+#include "analysis-worker.h"
+#include "input-source.h"
+#include "pipewire-session.h"
 #include "pipewire/stream.h"
-#include "pipewire/thread-loop.h"
 #include "spa/param/audio/format.h"
+#include <atomic>
 #include <cstddef>
 #include <functional>
 #include <memory>
@@ -8,35 +11,77 @@
 #include <vector>
 
 namespace Visualizer {
-class AudioStream {
+class AudioStream : public audio::InputSource {
 public:
-  using FreqCallback = std::function<void(std::vector<float>, int)>;
+  using FreqCallback = audio::FrameCallback;
 
   struct Context {
-    struct pw_thread_loop *loop;
     struct pw_stream *stream;
+    struct spa_hook listener;
     struct spa_audio_info format;
     unsigned move : 1;
   };
 
-  AudioStream(std::string source_name, size_t sample_rate, size_t buffer_size,
-              FreqCallback freq_callback)
-      : source_name_(std::move(source_name)), sample_rate_(sample_rate),
-        buffer_size_(buffer_size), freq_callback_(freq_callback),
+  // freq_callback runs on the stream's analysis worker thread, never on the
+  // PipeWire real-time thread.
+  // The callback receives stft.window_size samples every stft.hop_size
+  // samples, whatever quantum the graph runs at.
+  // The session must outlive the stream.
+  // target_object names the node to capture, by node name or object serial,
+  // source_name if empty. An explicit target is never swapped for another
+  // node when it goes away, the stream just stops receiving.
+  AudioStream(PipewireSession &session, std::string source_name,
+              size_t sample_rate, audio::StftOptions stft,
+              FreqCallback freq_callback,
+              audio::AnalysisWorkerOptions worker_options =
+                  audio::AnalysisWorkerOptions{},
+              std::string target_object = "")
+      : session_(session), source_name_(std::move(source_name)),
+        target_object_(std::move(target_object)), sample_rate_(sample_rate),
+        buffer_size_(stft.window_size), freq_callback_(freq_callback),
+        captured_rate_(sample_rate),
+        worker_(source_name_ + "_fft", stft, buffer_size_ * kRingBlocks,
+                [this](const audio::StftFrame &frame) {
+                  freq_callback_(frame,
+                                 captured_rate_.load(std::memory_order_relaxed));
+                },
+                worker_options),
         context_(CreateContext()) {}
-  void Start();
-  void Stop();
+  ~AudioStream() override { Stop(); }
+
+  AudioStream(const AudioStream &) = delete;
+  AudioStream &operator=(const AudioStream &) = delete;
+
+  // Attaches the stream to the session's graph, Stop detaches and destroys
+  // it. Other streams on the same session are unaffected.
+  const std::string &Name() const override { return source_name_; }
+  void Start() override;
+  void Stop() override;
   void OnProcess();
   void OnStreamParamChanged(uint32_t id, const struct spa_pod *param);
 
+  audio::AnalysisWorker::Stats WorkerStats() const {
+    return worker_.GetStats();
+  }
+
 private:
+  // Windows of headroom in the ring before the capture side starts dropping.
+  static constexpr size_t kRingBlocks = 4;
+
   std::unique_ptr<Context> CreateContext();
+  // CLOCK_MONOTONIC time the newest sample of the current buffer was
+  // captured.
+  int64_t CaptureTime() const;
 
+  PipewireSession &session_;
   std::string source_name_;
+  std::string target_object_;
   size_t sample_rate_;
   size_t buffer_size_;
 
   FreqCallback freq_callback_;
+  std::atomic<int> captured_rate_;
+  audio::AnalysisWorker worker_;
   std::unique_ptr<Context> context_;
 };
 } // namespace Visualizer
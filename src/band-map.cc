@@ -0,0 +1,173 @@
+#include "band-map.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+
+namespace audio {
+namespace {
+
+std::shared_mutex band_map_mtx;
+std::map<BandMapKey, BandMap> band_maps;
+
+float hzToScale(BandScale scale, float hz) {
+  switch (scale) {
+  case BandScale::kMel:
+    return 2595.0f * std::log10(1.0f + hz / 700.0f);
+  case BandScale::kBark: // Traunmüller
+    return 26.81f * hz / (1960.0f + hz) - 0.53f;
+  default:
+    return std::log(hz);
+  }
+}
+
+float scaleToHz(BandScale scale, float value) {
+  switch (scale) {
+  case BandScale::kMel:
+    return 700.0f * (std::pow(10.0f, value / 2595.0f) - 1.0f);
+  case BandScale::kBark:
+    return 1960.0f * (value + 0.53f) / (26.28f - value);
+  default:
+    return std::exp(value);
+  }
+}
+
+} // namespace
+
+const BandMap &BandMap::Get(const BandMapKey &key) {
+  {
+    std::shared_lock<std::shared_mutex> lock(band_map_mtx);
+    auto it = band_maps.find(key);
+    if (it != band_maps.end())
+      return it->second;
+  }
+  std::unique_lock<std::shared_mutex> lock(band_map_mtx);
+  auto it = band_maps.find(key);
+  if (it == band_maps.end())
+    it = band_maps.emplace(key, Build(key)).first;
+  return it->second;
+}
+
+BandMap BandMap::Build(const BandMapKey &key) {
+  BandMap map(key);
+  map.bin_width_ = static_cast<float>(key.sample_rate) / key.fft_size;
+  Layout(map);
+  return map;
+}
+
+BandMap BandMap::BuildForBins(const BandMapKey &key,
+                              std::vector<float> bin_frequencies) {
+  BandMap map(key);
+  map.bin_frequencies_ = std::move(bin_frequencies);
+  // The finest spacing, bounds the lowest band like the FFT bin width does.
+  map.bin_width_ = map.bin_frequencies_.size() > 1
+                       ? map.bin_frequencies_[1] - map.bin_frequencies_[0]
+                       : static_cast<float>(key.sample_rate) / key.fft_size;
+  if (map.key_.scale == BandScale::kGeometric)
+    map.key_.scale = BandScale::kLog;
+  Layout(map);
+  return map;
+}
+
+void BandMap::Layout(BandMap &map) {
+  const BandMapKey &key = map.key_;
+  const std::vector<float> &bin_frequencies = map.bin_frequencies_;
+  const size_t out_size = bin_frequencies.empty() ? key.fft_size / 2 + 1
+                                                  : bin_frequencies.size();
+
+  auto add_band = [&](size_t first, size_t last, float center) {
+    first = std::min(first, out_size - 1);
+    last = std::clamp(last, first + 1, out_size);
+    map.bands_.push_back({.first_bin = static_cast<uint32_t>(first),
+                          .last_bin = static_cast<uint32_t>(last),
+                          .center_frequency = center,
+                          .weight = 1.0f / (last - first)});
+  };
+  auto to_bin = [&](float hz) {
+    if (bin_frequencies.empty())
+      return static_cast<size_t>(std::lround(hz / map.bin_width_));
+    // First bin at or above hz.
+    return static_cast<size_t>(
+        std::lower_bound(bin_frequencies.begin(), bin_frequencies.end(), hz) -
+        bin_frequencies.begin());
+  };
+
+  const float nyquist = key.sample_rate / 2.0f;
+  const float max_hz = std::min(key.max_frequency, nyquist);
+  const float min_hz = std::clamp(key.min_frequency, map.bin_width_, max_hz);
+
+  switch (key.scale) {
+  case BandScale::kGeometric: {
+    float f = 1.0f;
+    for (; static_cast<size_t>(f) < out_size / 2;
+         f = geometric::ceilConstexpr(f * geometric::kStep)) {
+      size_t first = static_cast<size_t>(f);
+      size_t last = std::min(
+          static_cast<size_t>(geometric::ceilConstexpr(f * geometric::kStep)),
+          out_size / 2);
+      add_band(first, last, (first + last) * 0.5f * map.bin_width_);
+    }
+    break;
+  }
+  case BandScale::kThirdOctave: {
+    // k = 0 is 1 kHz, band edges are the centre times 2^(+-1/6).
+    int k_min = static_cast<int>(std::ceil(3.0f * std::log2(min_hz / 1000.0f)));
+    int k_max =
+        static_cast<int>(std::floor(3.0f * std::log2(max_hz / 1000.0f)));
+    for (int k = k_min; k <= k_max; ++k) {
+      float center = 1000.0f * std::exp2(k / 3.0f);
+      float low = center * std::exp2(-1.0f / 6.0f);
+      float high = std::min(center * std::exp2(1.0f / 6.0f), nyquist);
+      add_band(to_bin(low), to_bin(high), center);
+    }
+    break;
+  }
+  case BandScale::kLog:
+  case BandScale::kMel:
+  case BandScale::kBark: {
+    const size_t count = std::max<size_t>(key.band_count, 1);
+    const float lo = hzToScale(key.scale, min_hz);
+    const float hi = hzToScale(key.scale, max_hz);
+    const float step = (hi - lo) / count;
+    for (size_t i = 0; i < count; ++i) {
+      float low = scaleToHz(key.scale, lo + i * step);
+      float high = scaleToHz(key.scale, lo + (i + 1) * step);
+      float center = scaleToHz(key.scale, lo + (i + 0.5f) * step);
+      add_band(to_bin(low), to_bin(high), center);
+    }
+    break;
+  }
+  }
+}
+
+void BandMap::Reduce(const float *magnitudes, float *amplitudes,
+                     float *frequencies) const {
+  if (key_.reduction == BandReduction::kMean) {
+    for (size_t b = 0; b < bands_.size(); ++b) {
+      const Band &band = bands_[b];
+      float sum = 0.0f;
+      for (uint32_t q = band.first_bin; q < band.last_bin; ++q)
+        sum += magnitudes[q];
+      amplitudes[b] = sum * band.weight;
+      frequencies[b] = band.center_frequency;
+    }
+    return;
+  }
+
+  for (size_t b = 0; b < bands_.size(); ++b) {
+    const Band &band = bands_[b];
+    float peak = 0.0f;
+    uint32_t peak_bin = band.first_bin;
+    for (uint32_t q = band.first_bin; q < band.last_bin; ++q) {
+      if (magnitudes[q] > peak) {
+        peak = magnitudes[q];
+        peak_bin = q;
+      }
+    }
+    amplitudes[b] = peak;
+    frequencies[b] = peak > 0.0f ? BinFrequency(peak_bin) : 0.0f;
+  }
+}
+
+} // namespace audio
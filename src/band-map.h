@@ -0,0 +1,108 @@
+#pragma once
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace audio {
+
+enum class BandScale {
+  // The original squashing: bin ranges growing by 6% per band, up to a
+  // quarter of the FFT size. Band count follows from the FFT size.
+  kGeometric,
+  kLog,
+  kMel,
+  kBark,
+  // Standard 1/3 octave bands (centres 1000 * 2^(k/3) Hz). Band count follows
+  // from the frequency range.
+  kThirdOctave,
+};
+
+enum class BandReduction {
+  // Loudest bin of the band, reported with that bin's frequency.
+  kPeak,
+  // Weighted mean of the band's bins, reported with the band centre.
+  kMean,
+};
+
+struct BandMapKey {
+  size_t fft_size;
+  size_t sample_rate;
+  BandScale scale = BandScale::kGeometric;
+  // Ignored by kGeometric and kThirdOctave.
+  size_t band_count = 64;
+  float min_frequency = 20.0f;
+  float max_frequency = 20000.0f;
+  BandReduction reduction = BandReduction::kPeak;
+
+  auto operator<=>(const BandMapKey &) const = default;
+};
+
+struct Band {
+  // Bins [first_bin, last_bin) of the r2c output, never empty. Neighbouring
+  // bands may share a bin where the scale is finer than the FFT resolution.
+  uint32_t first_bin;
+  uint32_t last_bin;
+  float center_frequency;
+  // Applied to every bin by kMean, 1 / bin count.
+  float weight;
+};
+
+// Mapping from FFT bins to display bands, built once per key. Reducing a
+// spectrum is a single pass over contiguous bin ranges.
+class BandMap {
+public:
+  // Cached, the reference stays valid for the lifetime of the process.
+  static const BandMap &Get(const BandMapKey &key);
+  static BandMap Build(const BandMapKey &key);
+  // For spectra whose bins are not evenly spaced, e.g. a multi-resolution
+  // merge. bin_frequencies is ascending, one entry per bin; kGeometric is
+  // laid out like kLog with key.band_count bands. Not cached.
+  static BandMap BuildForBins(const BandMapKey &key,
+                              std::vector<float> bin_frequencies);
+
+  size_t size() const { return bands_.size(); }
+  const std::vector<Band> &Bands() const { return bands_; }
+  const BandMapKey &Key() const { return key_; }
+
+  // magnitudes holds fft_size / 2 + 1 bins (one per bin frequency for maps
+  // from BuildForBins), amplitudes and frequencies receive size() bands.
+  void Reduce(const float *magnitudes, float *amplitudes,
+              float *frequencies) const;
+
+private:
+  explicit BandMap(const BandMapKey &key) : key_(key) {}
+  static void Layout(BandMap &map);
+  float BinFrequency(uint32_t bin) const {
+    return bin_frequencies_.empty() ? bin * bin_width_ : bin_frequencies_[bin];
+  }
+
+  BandMapKey key_;
+  float bin_width_ = 0.0f;
+  // Empty for evenly spaced bins.
+  std::vector<float> bin_frequencies_;
+  std::vector<Band> bands_;
+};
+
+// The kGeometric layout, usable at compile time for fixed FFT sizes.
+namespace geometric {
+
+constexpr float kStep = 1.06f;
+
+constexpr float ceilConstexpr(float f) {
+  auto truncated = static_cast<float>(static_cast<int64_t>(f));
+  return truncated < f ? truncated + 1.0f : truncated;
+}
+
+// Number of bands for a spectrum of out_size = fft_size / 2 + 1 bins.
+constexpr size_t bandCount(size_t out_size) {
+  size_t count = 0;
+  for (float f = 1.0f; static_cast<size_t>(f) < out_size / 2;
+       f = ceilConstexpr(f * kStep))
+    count++;
+  return count;
+}
+
+} // namespace geometric
+
+} // namespace audio
@@ -0,0 +1,134 @@
+#include "beat-tracker.h"
+#include <algorithm>
+#include <cmath>
+
+namespace audio {
+
+float BeatTracker::Flux(ProcessedAudioView buffer) {
+  const auto bands = buffer.band_amplitudes;
+  if (previous_levels_.size() != bands.size()) {
+    // New layout, nothing to compare against yet.
+    previous_levels_.assign(bands.size(), 0.0f);
+    for (size_t b = 0; b < bands.size(); ++b)
+      previous_levels_[b] = std::log1p(bands[b] * buffer.max_amplitude);
+    return 0.0f;
+  }
+  float sum = 0.0f;
+  for (size_t b = 0; b < bands.size(); ++b) {
+    // Bands are normalised per frame, flux wants the absolute level.
+    float level = std::log1p(bands[b] * buffer.max_amplitude);
+    sum += std::max(level - previous_levels_[b], 0.0f);
+    previous_levels_[b] = level;
+  }
+  return bands.empty() ? 0.0f : sum / bands.size();
+}
+
+void BeatTracker::Restart() {
+  // Keeps the capacity, Flux refills it without allocating.
+  previous_levels_.clear();
+  flux_[0] = flux_[1] = 0.0f;
+  threshold_[0] = threshold_[1] = 0.0f;
+}
+
+void BeatTracker::UpdateTempo(float onset_strength, float hop_seconds) {
+  constexpr size_t size = kMaxLag + 1;
+  hops_++;
+  strength_[hops_ % size] = onset_strength;
+
+  const float decay = std::exp(-hop_seconds / options_.tempo_memory_s);
+  for (size_t lag = 1; lag <= kMaxLag; ++lag)
+    autocorrelation_[lag] =
+        decay * autocorrelation_[lag] +
+        onset_strength * strength_[(hops_ + size - lag) % size];
+
+  const size_t lag_min = std::clamp<size_t>(
+      std::floor(60.0f / (options_.max_bpm * hop_seconds)), 1, kMaxLag);
+  const size_t lag_max = std::clamp<size_t>(
+      std::ceil(60.0f / (options_.min_bpm * hop_seconds)), lag_min, kMaxLag);
+  size_t best = 0;
+  float best_score = 0.0f;
+  for (size_t lag = lag_min; lag <= lag_max; ++lag) {
+    // Mild preference for tempi around 120 BPM against octave errors.
+    float octaves = std::log2(60.0f / (lag * hop_seconds) / 120.0f);
+    float score = autocorrelation_[lag] * std::exp(-0.5f * octaves * octaves);
+    if (score > best_score) {
+      best_score = score;
+      best = lag;
+    }
+  }
+  // Without clear periodic onsets (steady tones, silence) keep the last
+  // tempo rather than locking onto noise.
+  if (best == 0 ||
+      autocorrelation_[best] < options_.min_flux * options_.min_flux)
+    return;
+
+  float period = best;
+  if (best > 1 && best < kMaxLag) {
+    float left = autocorrelation_[best - 1];
+    float center = autocorrelation_[best];
+    float right = autocorrelation_[best + 1];
+    float curvature = left - 2.0f * center + right;
+    if (curvature < 0.0f)
+      period += std::clamp(0.5f * (left - right) / curvature, -0.5f, 0.5f);
+  }
+  period_hops_ = period;
+  bpm_ = 60.0f / (period * hop_seconds);
+}
+
+void BeatTracker::Process(ProcessedAudioView buffer, float hop_seconds,
+                          BeatInfo &beat) {
+  hop_seconds = std::max(hop_seconds, 1e-4f);
+  const float flux = Flux(buffer);
+  const float threshold = std::max(
+      mean_ + options_.threshold_k * std::sqrt(std::max(variance_, 0.0f)),
+      options_.min_flux);
+
+  // The previous hop is an onset if it peaks above its threshold. Picking
+  // one hop late costs one hop of latency but needs no lookahead buffer.
+  const bool onset = flux_[1] > threshold_[1] && flux_[1] >= flux_[0] &&
+                     flux_[1] > flux &&
+                     since_onset_s_ >= options_.min_onset_interval_s;
+  if (onset) {
+    onsets_++;
+    since_onset_s_ = hop_seconds;
+    // phase_ still is the previous hop's, pull it towards the nearest beat.
+    if (period_hops_ > 0.0f) {
+      float error = phase_ < 0.5f ? phase_ : phase_ - 1.0f;
+      phase_ -= options_.phase_correction * error;
+    }
+  } else {
+    since_onset_s_ += hop_seconds;
+  }
+
+  // Exponentially weighted mean and variance of the flux.
+  const float alpha = 1.0f - std::exp(-hop_seconds /
+                                      options_.threshold_memory_s);
+  const float delta = flux - mean_;
+  mean_ += alpha * delta;
+  variance_ = (1.0f - alpha) * (variance_ + alpha * delta * delta);
+
+  flux_[0] = flux_[1];
+  flux_[1] = flux;
+  threshold_[0] = threshold_[1];
+  threshold_[1] = threshold;
+
+  UpdateTempo(std::max(flux - mean_, 0.0f), hop_seconds);
+  if (period_hops_ > 0.0f) {
+    phase_ += 1.0f / period_hops_;
+    if (phase_ < 0.0f)
+      phase_ += 1.0f;
+    while (phase_ >= 1.0f) {
+      phase_ -= 1.0f;
+      beats_++;
+    }
+  }
+
+  beat = {.flux = flux,
+          .threshold = threshold,
+          .onsets = onsets_,
+          .beats = beats_,
+          .bpm = bpm_,
+          .beat_phase = phase_};
+}
+
+} // namespace audio
@@ -0,0 +1,76 @@
+#pragma once
+#include "processed-audio.h"
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace audio {
+
+struct BeatTrackerOptions {
+  // An onset needs flux above mean + threshold_k standard deviations of the
+  // recent flux.
+  float threshold_k = 1.5f;
+  // Time constant of that running mean and deviation.
+  float threshold_memory_s = 1.5f;
+  // Flux never counts as an onset below this, keeps steady tones quiet.
+  float min_flux = 0.02f;
+  // Onsets closer than this to the previous one are ignored.
+  float min_onset_interval_s = 0.1f;
+  float min_bpm = 60.0f;
+  float max_bpm = 200.0f;
+  // Time constant of the tempo autocorrelation.
+  float tempo_memory_s = 8.0f;
+  // How far an onset pulls the beat phase towards itself, 0 to 1.
+  float phase_correction = 0.2f;
+};
+
+// Onset detection and tempo tracking on band spectra, one call per analysis
+// hop. Spectral flux is the mean positive change of the log band levels;
+// onsets are its local maxima above an adaptive threshold. Tempo comes from
+// a leaky autocorrelation of the flux over the lags of min_bpm..max_bpm, and
+// a phase accumulator running at that tempo, nudged by every onset, predicts
+// the beats. Each call costs O(bands + lags) with memory fixed after the
+// first call for a band count.
+class BeatTracker {
+public:
+  explicit BeatTracker(BeatTrackerOptions options = BeatTrackerOptions{})
+      : options_(options) {}
+
+  // hop_seconds is the time since the previous call's spectrum.
+  void Process(ProcessedAudioView buffer, float hop_seconds,
+               BeatInfo &beat);
+  // The next spectrum does not follow on from the last one: no flux is taken
+  // across the gap and no onset picked from it. Tempo, phase and the running
+  // counts carry on.
+  void Restart();
+
+private:
+  // Covers 60 BPM at hops down to ~8 ms.
+  static constexpr size_t kMaxLag = 128;
+
+  float Flux(ProcessedAudioView buffer);
+  void UpdateTempo(float onset_strength, float hop_seconds);
+
+  BeatTrackerOptions options_;
+  std::vector<float> previous_levels_;
+
+  float mean_ = 0.0f;
+  float variance_ = 0.0f;
+  // Flux and threshold of the last two hops, peaks are picked one hop late.
+  float flux_[2] = {};
+  float threshold_[2] = {};
+  float since_onset_s_ = 0.0f;
+
+  // Onset strength history, ring indexed by hop count.
+  std::array<float, kMaxLag + 1> strength_{};
+  std::array<float, kMaxLag + 1> autocorrelation_{};
+  size_t hops_ = 0;
+  // Beat period in hops, 0 until the autocorrelation has a peak.
+  float period_hops_ = 0.0f;
+  float bpm_ = 0.0f;
+  float phase_ = 0.0f;
+  uint64_t onsets_ = 0;
+  uint64_t beats_ = 0;
+};
+
+} // namespace audio
@@ -0,0 +1,124 @@
+#include "capture-manager.h"
+#include "audio-stream.h"
+#include "clock.h"
+#include "multi-resolution.h"
+#include "paced-source.h"
+#include "shared-spectrum.h"
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+
+namespace Visualizer {
+
+CaptureManager::CaptureManager(PipewireSession &session,
+                               CaptureOptions options)
+    : session_(session), options_(std::move(options)),
+      silence_(audio::MultiResolutionAnalyzer::BinCount(
+          options_.stft.window_size, options_.fft.resolution_levels)) {}
+
+CaptureManager::~CaptureManager() {
+  for (size_t i = captures_.size(); i-- > 0;)
+    Detach(i);
+}
+
+CaptureManager::Capture &CaptureManager::Add(uint32_t node_id,
+                                             uint64_t node_serial,
+                                             std::string name,
+                                             size_t sample_rate) {
+  auto capture = std::make_unique<Capture>(Capture{
+      .node_id = node_id, .node_serial = node_serial, .name = std::move(name)});
+  capture->processor = std::make_unique<audio::AudioProcessor>(
+      capture->name, sample_rate, options_.stft.window_size, options_.fft);
+  if (options_.publish) {
+    auto writer = std::make_unique<audio::SharedSpectrumWriter>(
+        audio::sharedSpectrumName(capture->name, capture->node_serial,
+                                  options_.publish_role));
+    fprintf(stderr, "publishing %s as %s\n", capture->name.c_str(),
+            writer->Name().c_str());
+    capture->processor->PublishTo(std::move(writer));
+  }
+  captures_.push_back(std::move(capture));
+  return *captures_.back();
+}
+
+void CaptureManager::Detach(size_t index) {
+  captures_[index]->source->Stop();
+  captures_.erase(captures_.begin() + index);
+  if (captures_.empty()) {
+    // A fresh timestamp, so the render side takes the silence like any new
+    // frame instead of holding on to the last one it saw.
+    silence_.timing.publish_ns = audio::monotonicNs();
+  }
+}
+
+bool CaptureManager::IsCaptured(const AudioNode &node) const {
+  return std::any_of(captures_.begin(), captures_.end(),
+                     [&](const std::unique_ptr<Capture> &capture) {
+                       return capture->node_id == node.id &&
+                              capture->node_serial == node.serial;
+                     });
+}
+
+void CaptureManager::Reconcile(const std::vector<AudioNode> &nodes) {
+  for (size_t i = captures_.size(); i-- > 0;) {
+    const Capture &capture = *captures_[i];
+    if (capture.node_id == kNoNode)
+      continue;
+    // Ids are reused, the serial tells a restarted node from the old one.
+    bool present = std::any_of(
+        nodes.begin(), nodes.end(), [&](const AudioNode &node) {
+          return node.id == capture.node_id &&
+                 node.serial == capture.node_serial &&
+                 options_.selector.Matches(node);
+        });
+    if (!present) {
+      fprintf(stderr, "%s (node %u) went away\n", capture.name.c_str(),
+              capture.node_id);
+      Detach(i);
+    }
+  }
+
+  for (const AudioNode &node : nodes) {
+    if (captures_.size() >= options_.max_sources)
+      break;
+    if (!options_.selector.Matches(node) || IsCaptured(node))
+      continue;
+    Capture &capture =
+        Add(node.id, node.serial,
+            node.name.empty() ? node.description : node.name,
+            options_.sample_rate);
+    audio::AudioProcessor *processor = capture.processor.get();
+    // The serial pins the stream to this very node, a name could resolve to
+    // another one of the same name.
+    std::string target =
+        node.serial != 0 ? std::to_string(node.serial) : node.name;
+    capture.source = std::make_unique<AudioStream>(
+        session_, capture.name, options_.sample_rate, options_.stft,
+        [processor](const audio::StftFrame &frame, size_t sample_rate) {
+          processor->OnNewSample(frame);
+        },
+        options_.worker, std::move(target));
+    fprintf(stderr, "capturing %s (node %u, %s)\n", capture.name.c_str(),
+            node.id, node.media_class.c_str());
+    capture.source->Start();
+  }
+}
+
+void CaptureManager::AttachReader(const std::string &name,
+                                  std::unique_ptr<audio::SampleReader> reader) {
+  Capture &capture = Add(kNoNode, 0, name, reader->Format().sample_rate);
+  audio::AudioProcessor *processor = capture.processor.get();
+  capture.source = std::make_unique<audio::PacedSource>(
+      name, std::move(reader), options_.stft,
+      [processor](const audio::StftFrame &frame, size_t sample_rate) {
+        processor->OnNewSample(frame);
+      },
+      options_.worker);
+  capture.source->Start();
+}
+
+const audio::ProcessedAudioFrame &CaptureManager::Frame() {
+  return captures_.empty() ? silence_ : captures_.front()->processor->Buffer();
+}
+
+} // namespace Visualizer
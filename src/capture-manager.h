@@ -0,0 +1,88 @@
+#pragma once
+#include "analysis-worker.h"
+#include "audio-processor.h"
+#include "input-source.h"
+#include "node-registry.h"
+#include "pipewire-session.h"
+#include "processed-audio.h"
+#include "stft.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Visualizer {
+
+struct CaptureOptions {
+  NodeSelector selector;
+  // Matching nodes captured at the same time, further ones wait for a free
+  // slot.
+  size_t max_sources = 1;
+  // Asked of the graph and assumed by the analysis.
+  size_t sample_rate = 48000;
+  audio::StftOptions stft;
+  audio::FftOptions fft;
+  // Given to every capture, with a scheduler the captures share its threads.
+  audio::AnalysisWorkerOptions worker;
+  // Share every capture's analysis, see shared-spectrum.h.
+  bool publish = false;
+  // Part of the shared memory names, so managers capturing the same node
+  // with other settings publish it under different ones.
+  std::string publish_role;
+};
+
+// The capture streams and AudioProcessors for the nodes a NodeSelector picks,
+// attached when a node appears and detached when it goes away, so sources can
+// come, go and restart under a running render loop. Used from one thread,
+// the render loop.
+class CaptureManager {
+public:
+  static constexpr uint32_t kNoNode = UINT32_MAX;
+
+  struct Capture {
+    // kNoNode for AttachReader captures.
+    uint32_t node_id;
+    uint64_t node_serial;
+    std::string name;
+    // Declared first so it outlives the source feeding it.
+    std::unique_ptr<audio::AudioProcessor> processor;
+    std::unique_ptr<audio::InputSource> source;
+  };
+
+  CaptureManager(PipewireSession &session, CaptureOptions options);
+  ~CaptureManager();
+
+  CaptureManager(const CaptureManager &) = delete;
+  CaptureManager &operator=(const CaptureManager &) = delete;
+
+  // Detaches captures whose node is gone and attaches matching nodes not
+  // captured yet, in the order given, up to max_sources. nodes is the whole
+  // graph, as from NodeRegistry::Nodes.
+  void Reconcile(const std::vector<AudioNode> &nodes);
+  // Captures a file or synthetic signal at real-time pace instead of a node.
+  // Counts towards max_sources and is never detached by Reconcile.
+  void AttachReader(const std::string &name,
+                    std::unique_ptr<audio::SampleReader> reader);
+
+  // Oldest first.
+  const std::vector<std::unique_ptr<Capture>> &Captures() const {
+    return captures_;
+  }
+  bool IsCaptured(const AudioNode &node) const;
+  // Newest analysis of the oldest capture, or a silent frame while nothing
+  // is captured. Same contract as AudioProcessor::Buffer.
+  const audio::ProcessedAudioFrame &Frame();
+
+private:
+  Capture &Add(uint32_t node_id, uint64_t node_serial, std::string name,
+               size_t sample_rate);
+  void Detach(size_t index);
+
+  PipewireSession &session_;
+  CaptureOptions options_;
+  std::vector<std::unique_ptr<Capture>> captures_;
+  audio::ProcessedAudioFrame silence_;
+};
+
+} // namespace Visualizer
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+#include <ctime>
+
+namespace audio {
+
+// CLOCK_MONOTONIC in ns, the clock PipeWire's pw_time.now is expressed in.
+inline int64_t monotonicNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+} // namespace audio
@@ -0,0 +1,177 @@
+#include "fft-plan-cache.h"
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <mutex>
+#include <utility>
+
+namespace audio {
+namespace {
+FftPlanCacheOptions &pendingOptions() {
+  static FftPlanCacheOptions options{.wisdom_dir = defaultWisdomDir()};
+  return options;
+}
+} // namespace
+
+std::string defaultWisdomDir() {
+  if (const char *cache_home = std::getenv("XDG_CACHE_HOME"))
+    return std::string(cache_home) + "/audio-visualizer";
+  if (const char *home = std::getenv("HOME"))
+    return std::string(home) + "/.cache/audio-visualizer";
+  return "";
+}
+
+FftPlanCache &FftPlanCache::Instance() {
+  static FftPlanCache cache(pendingOptions());
+  return cache;
+}
+
+void FftPlanCache::Configure(FftPlanCacheOptions options) {
+  pendingOptions() = std::move(options);
+}
+
+FftPlanCache::FftPlanCache(FftPlanCacheOptions options)
+    : options_(std::move(options)) {
+  if (options_.wisdom_dir.empty())
+    return;
+  fftwf_import_wisdom_from_filename(
+      WisdomPath(FftPrecision::kSingle).c_str());
+  fftw_import_wisdom_from_filename(WisdomPath(FftPrecision::kDouble).c_str());
+}
+
+FftPlanCache::~FftPlanCache() {
+  SaveWisdom();
+  std::unique_lock<std::shared_mutex> lock(mtx_);
+  for (auto &[key, plan] : plans_) {
+    if (plan.single)
+      fftwf_destroy_plan(plan.single);
+    if (plan.dbl)
+      fftw_destroy_plan(plan.dbl);
+  }
+  plans_.clear();
+  fftwf_cleanup();
+  fftw_cleanup();
+}
+
+fftwf_plan FftPlanCache::RealToComplexF(size_t size, size_t howmany) {
+  return Lookup({size, FftDirection::kRealToComplex, FftPrecision::kSingle, howmany})
+      .single;
+}
+
+fftwf_plan FftPlanCache::ComplexToRealF(size_t size, size_t howmany) {
+  return Lookup({size, FftDirection::kComplexToReal, FftPrecision::kSingle, howmany})
+      .single;
+}
+
+fftw_plan FftPlanCache::RealToComplex(size_t size, size_t howmany) {
+  return Lookup({size, FftDirection::kRealToComplex, FftPrecision::kDouble, howmany})
+      .dbl;
+}
+
+fftw_plan FftPlanCache::ComplexToReal(size_t size, size_t howmany) {
+  return Lookup({size, FftDirection::kComplexToReal, FftPrecision::kDouble, howmany})
+      .dbl;
+}
+
+void FftPlanCache::SaveWisdom() {
+  std::unique_lock<std::shared_mutex> lock(mtx_);
+  if (!wisdom_dirty_ || options_.wisdom_dir.empty())
+    return;
+  std::error_code ec;
+  std::filesystem::create_directories(options_.wisdom_dir, ec);
+  if (ec) {
+    fprintf(stderr, "fftw: cannot create wisdom dir %s: %s\n",
+            options_.wisdom_dir.c_str(), ec.message().c_str());
+    return;
+  }
+  fftwf_export_wisdom_to_filename(WisdomPath(FftPrecision::kSingle).c_str());
+  fftw_export_wisdom_to_filename(WisdomPath(FftPrecision::kDouble).c_str());
+  wisdom_dirty_ = false;
+}
+
+FftPlanCache::CachedPlan FftPlanCache::Lookup(const FftPlanKey &key) {
+  // Plans live as long as the process, so every thread can remember the last
+  // few it used. The steady state then never touches the lock, whose cache
+  // line all analysis threads would otherwise fight over.
+  struct Recent {
+    FftPlanKey key;
+    CachedPlan plan;
+  };
+  thread_local std::array<Recent, 4> recent{};
+  thread_local size_t recent_next = 0;
+  for (const Recent &entry : recent) {
+    if ((entry.plan.single != nullptr || entry.plan.dbl != nullptr) &&
+        entry.key == key)
+      return entry.plan;
+  }
+
+  CachedPlan plan = LookupLocked(key);
+  recent[recent_next++ % recent.size()] = {key, plan};
+  return plan;
+}
+
+FftPlanCache::CachedPlan FftPlanCache::LookupLocked(const FftPlanKey &key) {
+  {
+    std::shared_lock<std::shared_mutex> lock(mtx_);
+    auto it = plans_.find(key);
+    if (it != plans_.end())
+      return it->second;
+  }
+
+  std::unique_lock<std::shared_mutex> lock(mtx_);
+  auto it = plans_.find(key);
+  if (it != plans_.end())
+    return it->second;
+  auto plan = CreatePlan(key);
+  plans_.emplace(key, plan);
+  wisdom_dirty_ = true;
+  return plan;
+}
+
+// Called with mtx_ held exclusively, the FFTW planner is not thread safe.
+FftPlanCache::CachedPlan FftPlanCache::CreatePlan(const FftPlanKey &key) {
+  const int n = static_cast<int>(key.size);
+  const int howmany = static_cast<int>(key.howmany);
+  const int complex_size = n / 2 + 1;
+  const size_t real_count = key.size * key.howmany;
+  const size_t complex_count = complex_size * key.howmany;
+  CachedPlan plan;
+
+  // Planning with MEASURE/PATIENT scribbles over the arrays, so plan on
+  // scratch buffers with the same alignment the callers will use.
+  if (key.precision == FftPrecision::kSingle) {
+    auto real = allocFftwfReal(real_count);
+    auto complex = allocFftwfComplex(complex_count);
+    if (key.direction == FftDirection::kRealToComplex)
+      plan.single = fftwf_plan_many_dft_r2c(
+          1, &n, howmany, real.get(), nullptr, 1, n, complex.get(), nullptr,
+          1, complex_size, options_.planner_flags);
+    else
+      plan.single = fftwf_plan_many_dft_c2r(
+          1, &n, howmany, complex.get(), nullptr, 1, complex_size, real.get(),
+          nullptr, 1, n, options_.planner_flags);
+  } else {
+    auto *real = fftw_alloc_real(real_count);
+    auto *complex = fftw_alloc_complex(complex_count);
+    if (key.direction == FftDirection::kRealToComplex)
+      plan.dbl = fftw_plan_many_dft_r2c(1, &n, howmany, real, nullptr, 1, n,
+                                        complex, nullptr, 1, complex_size,
+                                        options_.planner_flags);
+    else
+      plan.dbl = fftw_plan_many_dft_c2r(1, &n, howmany, complex, nullptr, 1,
+                                        complex_size, real, nullptr, 1, n,
+                                        options_.planner_flags);
+    fftw_free(real);
+    fftw_free(complex);
+  }
+  return plan;
+}
+
+std::string FftPlanCache::WisdomPath(FftPrecision precision) const {
+  return options_.wisdom_dir +
+         (precision == FftPrecision::kSingle ? "/fftwf.wisdom"
+                                             : "/fftw.wisdom");
+}
+
+} // namespace audio
@@ -0,0 +1,88 @@
+#pragma once
+#include <compare>
+#include <cstddef>
+#include <fftw3.h>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+
+namespace audio {
+
+enum class FftDirection { kRealToComplex, kComplexToReal };
+enum class FftPrecision { kSingle, kDouble };
+
+struct FftPlanKey {
+  size_t size;
+  FftDirection direction;
+  FftPrecision precision;
+  // Number of contiguous transforms batched into one plan.
+  size_t howmany = 1;
+
+  auto operator<=>(const FftPlanKey &) const = default;
+};
+
+struct FftPlanCacheOptions {
+  // FFTW_MEASURE or FFTW_PATIENT. Only paid once per key thanks to wisdom.
+  unsigned planner_flags = FFTW_MEASURE;
+  // Directory holding the wisdom files, empty disables persistence.
+  std::string wisdom_dir;
+};
+
+template <typename T> struct FftwfDeleter {
+  void operator()(T *ptr) const { fftwf_free(ptr); }
+};
+template <typename T> using FftwfBuffer = std::unique_ptr<T[], FftwfDeleter<T>>;
+
+// SIMD aligned buffers, suitable for the new-array execute functions.
+inline FftwfBuffer<float> allocFftwfReal(size_t count) {
+  return FftwfBuffer<float>(fftwf_alloc_real(count));
+}
+inline FftwfBuffer<fftwf_complex> allocFftwfComplex(size_t count) {
+  return FftwfBuffer<fftwf_complex>(fftwf_alloc_complex(count));
+}
+
+// Plans every (size, direction, precision) once and keeps it for the lifetime
+// of the process. Planning happens under an exclusive lock, lookups of already
+// known plans only take a shared one, and none for the few plans a thread
+// used last. The returned plans must be run with the fftw(f)_execute_dft_*
+// new-array functions on fftw(f)_malloc'd buffers.
+class FftPlanCache {
+public:
+  static FftPlanCache &Instance();
+
+  // Must be called before the first plan is requested to have any effect.
+  static void Configure(FftPlanCacheOptions options);
+
+  ~FftPlanCache();
+
+  // Batched plans (howmany > 1) expect rows of size reals and size / 2 + 1
+  // complex values, laid out back to back.
+  fftwf_plan RealToComplexF(size_t size, size_t howmany = 1);
+  fftwf_plan ComplexToRealF(size_t size, size_t howmany = 1);
+  fftw_plan RealToComplex(size_t size, size_t howmany = 1);
+  fftw_plan ComplexToReal(size_t size, size_t howmany = 1);
+
+  void SaveWisdom();
+
+private:
+  struct CachedPlan {
+    fftwf_plan single = nullptr;
+    fftw_plan dbl = nullptr;
+  };
+
+  explicit FftPlanCache(FftPlanCacheOptions options);
+  CachedPlan Lookup(const FftPlanKey &key);
+  CachedPlan LookupLocked(const FftPlanKey &key);
+  CachedPlan CreatePlan(const FftPlanKey &key);
+  std::string WisdomPath(FftPrecision precision) const;
+
+  FftPlanCacheOptions options_;
+  std::shared_mutex mtx_;
+  std::map<FftPlanKey, CachedPlan> plans_;
+  bool wisdom_dirty_ = false;
+};
+
+std::string defaultWisdomDir();
+
+} // namespace audio
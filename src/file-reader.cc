@@ -0,0 +1,154 @@
+#include "file-reader.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace audio {
+namespace {
+
+constexpr uint16_t kWaveFormatPcm = 1;
+constexpr uint16_t kWaveFormatFloat = 3;
+constexpr uint16_t kWaveFormatExtensible = 0xFFFE;
+
+uint16_t le16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+uint32_t le32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+}
+
+bool endsWith(const std::string &s, const char *suffix) {
+  size_t n = std::strlen(suffix);
+  if (s.size() < n)
+    return false;
+  for (size_t i = 0; i < n; ++i)
+    if (std::tolower(s[s.size() - n + i]) != suffix[i])
+      return false;
+  return true;
+}
+
+} // namespace
+
+std::unique_ptr<WavReader> WavReader::Open(const std::string &path) {
+  std::unique_ptr<WavReader> reader(new WavReader());
+  reader->file_ = fopen(path.c_str(), "rb");
+  if (reader->file_ == nullptr) {
+    perror(path.c_str());
+    return nullptr;
+  }
+  FILE *f = reader->file_;
+
+  uint8_t header[12];
+  if (fread(header, 1, sizeof(header), f) != sizeof(header) ||
+      std::memcmp(header, "RIFF", 4) != 0 ||
+      std::memcmp(header + 8, "WAVE", 4) != 0) {
+    fprintf(stderr, "%s: not a RIFF/WAVE file\n", path.c_str());
+    return nullptr;
+  }
+
+  bool have_format = false;
+  uint8_t chunk[8];
+  while (fread(chunk, 1, sizeof(chunk), f) == sizeof(chunk)) {
+    uint32_t size = le32(chunk + 4);
+    if (std::memcmp(chunk, "fmt ", 4) == 0) {
+      uint8_t fmt[40] = {};
+      size_t len = std::min<size_t>(size, sizeof(fmt));
+      if (fread(fmt, 1, len, f) != len)
+        break;
+      fseek(f, (size - len) + (size & 1), SEEK_CUR);
+      uint16_t tag = le16(fmt);
+      if (tag == kWaveFormatExtensible && len >= 26)
+        tag = le16(fmt + 24); // first two bytes of the sub-format GUID
+      reader->format_.channels = le16(fmt + 2);
+      reader->format_.sample_rate = le32(fmt + 4);
+      reader->bits_per_sample_ = le16(fmt + 14);
+      reader->is_float_ = tag == kWaveFormatFloat;
+      bool supported =
+          (tag == kWaveFormatPcm && (reader->bits_per_sample_ == 16 ||
+                                     reader->bits_per_sample_ == 24 ||
+                                     reader->bits_per_sample_ == 32)) ||
+          (tag == kWaveFormatFloat && reader->bits_per_sample_ == 32);
+      if (!supported || reader->format_.channels == 0) {
+        fprintf(stderr, "%s: unsupported format %u, %u bits\n", path.c_str(),
+                tag, reader->bits_per_sample_);
+        return nullptr;
+      }
+      have_format = true;
+    } else if (std::memcmp(chunk, "data", 4) == 0) {
+      if (!have_format)
+        break;
+      reader->remaining_frames_ = size / (reader->bits_per_sample_ / 8) /
+                                  reader->format_.channels;
+      return reader;
+    } else {
+      fseek(f, size + (size & 1), SEEK_CUR);
+    }
+  }
+  fprintf(stderr, "%s: no usable fmt/data chunks\n", path.c_str());
+  return nullptr;
+}
+
+WavReader::~WavReader() {
+  if (file_)
+    fclose(file_);
+}
+
+size_t WavReader::Read(float *interleaved, size_t frames) {
+  frames = std::min<uint64_t>(frames, remaining_frames_);
+  const size_t bytes_per_sample = bits_per_sample_ / 8;
+  const size_t samples = frames * format_.channels;
+  raw_.resize(samples * bytes_per_sample);
+  size_t read_samples =
+      fread(raw_.data(), bytes_per_sample, samples, file_);
+  frames = read_samples / format_.channels;
+  remaining_frames_ = frames == 0 ? 0 : remaining_frames_ - frames;
+
+  const uint8_t *p = raw_.data();
+  const size_t n = frames * format_.channels;
+  if (is_float_) {
+    std::memcpy(interleaved, p, n * sizeof(float));
+  } else if (bits_per_sample_ == 16) {
+    for (size_t i = 0; i < n; ++i)
+      interleaved[i] = int16_t(le16(p + 2 * i)) / 32768.0f;
+  } else if (bits_per_sample_ == 24) {
+    for (size_t i = 0; i < n; ++i) {
+      const uint8_t *s = p + 3 * i;
+      int32_t v = (s[0] << 8) | (s[1] << 16) | (uint32_t(s[2]) << 24);
+      interleaved[i] = (v >> 8) / 8388608.0f;
+    }
+  } else {
+    for (size_t i = 0; i < n; ++i)
+      interleaved[i] = int32_t(le32(p + 4 * i)) / 2147483648.0f;
+  }
+  return frames;
+}
+
+std::unique_ptr<RawPcmReader> RawPcmReader::Open(const std::string &path,
+                                                 StreamFormat format) {
+  std::unique_ptr<RawPcmReader> reader(new RawPcmReader());
+  reader->file_ = fopen(path.c_str(), "rb");
+  if (reader->file_ == nullptr) {
+    perror(path.c_str());
+    return nullptr;
+  }
+  reader->format_ = format;
+  return reader;
+}
+
+RawPcmReader::~RawPcmReader() {
+  if (file_)
+    fclose(file_);
+}
+
+size_t RawPcmReader::Read(float *interleaved, size_t frames) {
+  size_t samples =
+      fread(interleaved, sizeof(float), frames * format_.channels, file_);
+  return samples / format_.channels;
+}
+
+std::unique_ptr<SampleReader> openAudioFile(const std::string &path,
+                                            StreamFormat raw_format) {
+  if (endsWith(path, ".wav"))
+    return WavReader::Open(path);
+  return RawPcmReader::Open(path, raw_format);
+}
+
+} // namespace audio
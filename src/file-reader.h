@@ -0,0 +1,55 @@
+#pragma once
+#include "input-source.h"
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace audio {
+
+// RIFF/WAVE reader for 16/24/32 bit integer PCM and 32 bit float, including
+// WAVE_FORMAT_EXTENSIBLE files.
+class WavReader : public SampleReader {
+public:
+  // Returns nullptr and reports on stderr if the file cannot be used.
+  static std::unique_ptr<WavReader> Open(const std::string &path);
+  ~WavReader() override;
+
+  StreamFormat Format() const override { return format_; }
+  size_t Read(float *interleaved, size_t frames) override;
+
+private:
+  WavReader() = default;
+
+  FILE *file_ = nullptr;
+  StreamFormat format_;
+  uint16_t bits_per_sample_ = 0;
+  bool is_float_ = false;
+  uint64_t remaining_frames_ = 0;
+  std::vector<uint8_t> raw_;
+};
+
+// Headerless interleaved 32 bit float samples, format given by the caller.
+class RawPcmReader : public SampleReader {
+public:
+  static std::unique_ptr<RawPcmReader> Open(const std::string &path,
+                                            StreamFormat format);
+  ~RawPcmReader() override;
+
+  StreamFormat Format() const override { return format_; }
+  size_t Read(float *interleaved, size_t frames) override;
+
+private:
+  RawPcmReader() = default;
+
+  FILE *file_ = nullptr;
+  StreamFormat format_;
+};
+
+// .wav files go through WavReader, anything else is read as raw float PCM
+// with raw_format.
+std::unique_ptr<SampleReader> openAudioFile(const std::string &path,
+                                            StreamFormat raw_format);
+
+} // namespace audio
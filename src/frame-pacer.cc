@@ -0,0 +1,136 @@
+#include "frame-pacer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace audio {
+namespace {
+
+// Weight of a new observation in the interval and delay averages.
+constexpr int64_t kAverageDivisor = 8;
+
+void Blend(const ProcessedAudioBuffer &from, const ProcessedAudioBuffer &to,
+           float t, ProcessedAudioBuffer &out) {
+  auto blend = [t](const auto &a, const auto &b, auto &result) {
+    result.resize(b.size());
+    for (size_t i = 0; i < b.size(); ++i)
+      result[i] = std::lerp(a[i], b[i], t);
+  };
+  blend(from.magnitudes, to.magnitudes, out.magnitudes);
+  // Complex bins are only there when asked for, in both frames or neither.
+  blend(from.re, to.re, out.re);
+  blend(from.im, to.im, out.im);
+  blend(from.band_amplitudes, to.band_amplitudes, out.band_amplitudes);
+  // Frequencies are those of the newer frame, a peak does not glide between
+  // bins.
+  out.band_frequencies = to.band_frequencies;
+  out.frequencies = to.frequencies;
+  out.max_amplitude = std::lerp(from.max_amplitude, to.max_amplitude, t);
+  out.avg_amplitude = std::lerp(from.avg_amplitude, to.avg_amplitude, t);
+}
+
+} // namespace
+
+bool FramePacer::Push(const ProcessedAudioFrame &frame, int64_t now_ns) {
+  const int64_t publish_ns = frame.timing.publish_ns;
+  if (publish_ns == 0) {
+    // Shown as is until something is published, so the renderers have bands
+    // to draw from the start.
+    if (count_ == 0 && output_.band_amplitudes.empty())
+      output_ = frame.mid;
+    return false;
+  }
+  if (publish_ns == last_publish_ns_)
+    return false;
+  last_publish_ns_ = publish_ns;
+  // Capture times are one hop apart, publish times jitter with scheduling.
+  Push(frame.mid,
+       frame.timing.capture_ns != 0 ? frame.timing.capture_ns : publish_ns,
+       now_ns);
+  return true;
+}
+
+void FramePacer::Push(ProcessedAudioView spectrum, int64_t time_ns,
+                      int64_t now_ns) {
+  if (count_ > 0) {
+    const int64_t spacing = time_ns - Back(0).time_ns;
+    if (spacing <= 0) {
+      // The source restarted, older frames do not line up with this one.
+      count_ = 0;
+    } else if (interval_ns_ == 0) {
+      interval_ns_ = spacing;
+    } else if (spacing < 4 * interval_ns_) {
+      // Longer gaps are dropouts, not a change of hop.
+      interval_ns_ += (spacing - interval_ns_) / kAverageDivisor;
+    }
+  }
+  const int64_t delay_ns = now_ns - time_ns;
+  delay_ns_ = count_ == 0 ? delay_ns
+                          : delay_ns_ + (delay_ns - delay_ns_) / kAverageDivisor;
+
+  newest_ = (newest_ + 1) % kQueueSize;
+  count_ = std::min(count_ + 1, kQueueSize);
+  // Same sizes every frame, so the copy reuses the entry's storage.
+  queue_[newest_].time_ns = time_ns;
+  ProcessedAudioBuffer &buffer = queue_[newest_].buffer;
+  buffer.magnitudes.assign(spectrum.magnitudes.begin(),
+                           spectrum.magnitudes.end());
+  buffer.re.assign(spectrum.re.begin(), spectrum.re.end());
+  buffer.im.assign(spectrum.im.begin(), spectrum.im.end());
+  buffer.frequencies = spectrum.frequencies;
+  buffer.band_amplitudes.assign(spectrum.band_amplitudes.begin(),
+                                spectrum.band_amplitudes.end());
+  buffer.band_frequencies.assign(spectrum.band_frequencies.begin(),
+                                 spectrum.band_frequencies.end());
+  buffer.max_amplitude = spectrum.max_amplitude;
+  buffer.avg_amplitude = spectrum.avg_amplitude;
+}
+
+const ProcessedAudioBuffer &FramePacer::Spectrum(int64_t now_ns) {
+  changed_ = false;
+  if (count_ == 0)
+    return output_;
+
+  const Entry *from = &Back(0);
+  const Entry *to = from;
+  float fraction = 0.0f;
+  if (options_.interpolate && count_ > 1 && interval_ns_ > 0) {
+    const int64_t display_ns = now_ns - delay_ns_ - interval_ns_;
+    for (size_t i = 1; i < count_; ++i) {
+      const Entry &older = Back(i);
+      if (older.time_ns > display_ns && i + 1 < count_)
+        continue;
+      const Entry &newer = Back(i - 1);
+      fraction = std::clamp(float(display_ns - older.time_ns) /
+                                float(newer.time_ns - older.time_ns),
+                            0.0f, 1.0f);
+      if (fraction < 1.0f) {
+        from = &older;
+        to = &newer;
+      } else {
+        from = to = &newer;
+        fraction = 0.0f;
+      }
+      break;
+    }
+  }
+  display_ns_ =
+      from->time_ns + int64_t(fraction * float(to->time_ns - from->time_ns));
+  // `to` always follows `from`, so it and the fraction identify the result.
+  if (from->time_ns == output_from_ns_ && fraction == output_fraction_)
+    return output_;
+  output_from_ns_ = from->time_ns;
+  output_fraction_ = fraction;
+  changed_ = true;
+
+  if (fraction > 0.0f &&
+      from->buffer.frequencies.data() == to->buffer.frequencies.data() &&
+      from->buffer.re.size() == to->buffer.re.size() &&
+      from->buffer.band_amplitudes.size() ==
+          to->buffer.band_amplitudes.size())
+    Blend(from->buffer, to->buffer, fraction, output_);
+  else
+    output_ = from->buffer;
+  return output_;
+}
+
+} // namespace audio
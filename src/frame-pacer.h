@@ -0,0 +1,78 @@
+#pragma once
+#include "processed-audio.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace audio {
+
+struct FramePacerOptions {
+  // Blend the two analysis frames around the display time. Off shows the
+  // newest frame as soon as it arrives.
+  bool interpolate = true;
+};
+
+// Render side of the analysis hand-off. Keeps the last few published mid
+// spectra with their audio timestamps and produces the spectrum for a
+// display time: a blend of the two frames bracketing it. The display runs
+// one analysis hop (plus the observed delivery latency) behind the newest
+// frame so there is nearly always a frame on either side, which gives smooth
+// motion at any refresh rate. Single threaded, called from the render loop.
+class FramePacer {
+public:
+  explicit FramePacer(FramePacerOptions options = FramePacerOptions{})
+      : options_(options) {}
+
+  void SetOptions(FramePacerOptions options) { options_ = options; }
+
+  // Takes frame into the queue if it was not seen yet. Returns whether it
+  // was new. Until a frame with a publish time arrives, an unpublished one
+  // (the silence shown while nothing is captured) is what Spectrum returns.
+  bool Push(const ProcessedAudioFrame &frame, int64_t now_ns);
+  // Queues a spectrum stamped time_ns that arrived at now_ns, for callers
+  // running on their own clock (offline rendering).
+  void Push(ProcessedAudioView spectrum, int64_t time_ns, int64_t now_ns);
+
+  // Spectrum to show at now_ns. When it would not differ from the previous
+  // call's (no new frame and already past the newest one) the previous result
+  // is returned untouched and Changed() is false.
+  const ProcessedAudioBuffer &Spectrum(int64_t now_ns);
+  bool Changed() const { return changed_; }
+  // Audio timestamp of what the last Spectrum call returned: the display time
+  // when interpolating, the newest frame's otherwise. 0 before any frame.
+  int64_t DisplayTimeNs() const { return display_ns_; }
+
+  // Time between analysis frames, estimated from their timestamps.
+  int64_t FrameIntervalNs() const { return interval_ns_; }
+
+private:
+  static constexpr size_t kQueueSize = 4;
+
+  struct Entry {
+    int64_t time_ns = 0;
+    ProcessedAudioBuffer buffer{0};
+  };
+
+  // Entry i positions back from the newest.
+  const Entry &Back(size_t i) const {
+    return queue_[(newest_ + kQueueSize - i) % kQueueSize];
+  }
+
+  FramePacerOptions options_;
+  std::array<Entry, kQueueSize> queue_;
+  size_t newest_ = 0;
+  size_t count_ = 0;
+  int64_t last_publish_ns_ = 0;
+  // Smoothed frame spacing and delivery delay (arrival minus timestamp).
+  int64_t interval_ns_ = 0;
+  int64_t delay_ns_ = 0;
+
+  ProcessedAudioBuffer output_{0};
+  // What output_ was made from, to tell when it can be reused.
+  int64_t output_from_ns_ = -1;
+  float output_fraction_ = -1.0f;
+  bool changed_ = false;
+  int64_t display_ns_ = 0;
+};
+
+} // namespace audio
@@ -0,0 +1,51 @@
+#include "frequency-table.h"
+#include <map>
+#include <mutex>
+#include <set>
+#include <utility>
+
+namespace audio {
+namespace {
+
+std::mutex table_mtx;
+// Node based, entries never move once inserted.
+std::set<std::vector<float>> tables;
+std::map<std::pair<size_t, size_t>, std::span<const float>> linear_tables;
+
+std::span<const float> intern(std::vector<float> frequencies) {
+  return *tables.insert(std::move(frequencies)).first;
+}
+
+} // namespace
+
+std::span<const float> linearFrequencyTable(size_t fft_size,
+                                            size_t sample_rate) {
+  // Asked for on every frame, remember the last one per thread so the steady
+  // state takes no lock.
+  thread_local size_t last_size = 0, last_rate = 0;
+  thread_local std::span<const float> last;
+  if (fft_size == last_size && sample_rate == last_rate)
+    return last;
+
+  std::lock_guard<std::mutex> lock(table_mtx);
+  auto [it, inserted] =
+      linear_tables.try_emplace({fft_size, sample_rate});
+  if (inserted) {
+    std::vector<float> frequencies(fft_size / 2 + 1);
+    const float bin_width = static_cast<float>(sample_rate) / fft_size;
+    for (size_t i = 0; i < frequencies.size(); ++i)
+      frequencies[i] = static_cast<float>(i) * bin_width;
+    it->second = intern(std::move(frequencies));
+  }
+  last_size = fft_size;
+  last_rate = sample_rate;
+  last = it->second;
+  return last;
+}
+
+std::span<const float> sharedFrequencyTable(std::vector<float> frequencies) {
+  std::lock_guard<std::mutex> lock(table_mtx);
+  return intern(std::move(frequencies));
+}
+
+} // namespace audio
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace audio {
+
+// Bin centre frequencies are a property of the analysis configuration, not
+// of a frame. Spectra point into these tables instead of carrying a copy.
+// Tables are built once and kept for the lifetime of the process.
+
+// Evenly spaced bins of an fft_size point real FFT, fft_size / 2 + 1 entries.
+std::span<const float> linearFrequencyTable(size_t fft_size,
+                                            size_t sample_rate);
+
+// Any other layout (e.g. multi-resolution merges). Equal tables are stored
+// once.
+std::span<const float> sharedFrequencyTable(std::vector<float> frequencies);
+
+} // namespace audio
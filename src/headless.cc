@@ -0,0 +1,76 @@
+#include "headless.h"
+#include "alloc-counter.h"
+#include "analysis-worker.h"
+#include "audio-processor.h"
+#include "simd-kernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace audio {
+
+int runHeadless(const HeadlessOptions &options) {
+  auto reader =
+      openSampleReader(options.input, options.raw_format, options.seconds);
+  if (!reader) {
+    fprintf(stderr, "headless: cannot open input %s\n",
+            options.input.c_str());
+    return 1;
+  }
+  const StreamFormat format = reader->Format();
+
+  Stft stft(options.stft, std::min(format.channels, kMaxAnalysedChannels));
+  AudioProcessor processor(options.input, format.sample_rate,
+                           stft.WindowSize(), options.fft);
+
+  std::vector<float> interleaved(stft.HopSize() * format.channels);
+  std::vector<std::vector<float>> planar(format.channels,
+                                         std::vector<float>(stft.HopSize()));
+  std::vector<float *> rows;
+  for (auto &row : planar)
+    rows.push_back(row.data());
+
+  uint64_t samples = 0;
+  uint64_t frames = 0;
+  float checksum = 0.0f;
+  BeatInfo beat;
+  LevelInfo levels;
+
+  const auto start = std::chrono::steady_clock::now();
+  while (size_t read = reader->Read(interleaved.data(), stft.HopSize())) {
+    NoAllocScope no_alloc("headless",
+                          frames >= AnalysisWorker::kWarmupFrames);
+    deinterleave(interleaved.data(), read, format.channels, rows.data());
+    stft.Push(rows.data(), read, [&](const StftFrame &frame) {
+      processor.OnNewSample(frame);
+      // Consume like the render loop would, keeps the work observable.
+      const ProcessedAudioFrame &processed = processor.Buffer();
+      checksum += processed.mid.avg_amplitude;
+      beat = processed.beat;
+      levels = processed.levels;
+      frames++;
+    });
+    samples += read;
+  }
+  const double wall = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+
+  const double audio_seconds = double(samples) / format.sample_rate;
+  fprintf(stdout,
+          "%s: %lu samples x %lu channels @ %lu Hz (%.1f s of audio)\n"
+          "  window %lu hop %lu levels %lu, %s kernels: %lu frames in %.3f s\n"
+          "  %.1fx real time, %.2f us/frame, checksum %g\n"
+          "  %lu onsets, tempo %.1f bpm\n"
+          "  integrated %.1f LUFS, true peak %.1f dBTP\n",
+          options.input.c_str(), samples, format.channels, format.sample_rate,
+          audio_seconds, stft.WindowSize(), stft.HopSize(),
+          options.fft.resolution_levels, kernels().name, frames, wall,
+          wall > 0 ? audio_seconds / wall : 0.0,
+          frames ? wall * 1e6 / frames : 0.0, checksum, beat.onsets,
+          beat.bpm, levels.integrated_lufs, levels.max_true_peak_dbtp);
+  return 0;
+}
+
+} // namespace audio
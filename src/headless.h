@@ -0,0 +1,23 @@
+#pragma once
+#include "audio-processing.h"
+#include "input-source.h"
+#include "stft.h"
+#include <string>
+
+namespace audio {
+
+struct HeadlessOptions {
+  // Synthetic signal spec or file path, see openSampleReader.
+  std::string input = "sine:440";
+  StreamFormat raw_format;
+  float seconds = 60.0f;
+  StftOptions stft;
+  FftOptions fft;
+};
+
+// Pushes the input through the same Stft + AudioProcessor path as a live
+// source, as fast as it goes, and reports the throughput. Returns the process
+// exit code.
+int runHeadless(const HeadlessOptions &options);
+
+} // namespace audio
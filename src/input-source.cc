@@ -0,0 +1,15 @@
+#include "input-source.h"
+#include "file-reader.h"
+#include "synth-reader.h"
+
+namespace audio {
+
+std::unique_ptr<SampleReader> openSampleReader(const std::string &spec,
+                                               StreamFormat raw_format,
+                                               float duration_seconds) {
+  if (auto synth = SynthReader::FromSpec(spec, raw_format, duration_seconds))
+    return synth;
+  return openAudioFile(spec, raw_format);
+}
+
+} // namespace audio
@@ -0,0 +1,48 @@
+#pragma once
+#include "stft.h"
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace audio {
+
+// Receives every analysis window of a source, on that source's analysis
+// thread.
+using FrameCallback =
+    std::function<void(const StftFrame &, size_t sample_rate)>;
+
+// A live source of audio that feeds its own analysis pipeline once started.
+// Implemented by the PipeWire capture (Visualizer::AudioStream) and by
+// PacedSource for files and synthetic signals.
+class InputSource {
+public:
+  virtual ~InputSource() = default;
+  virtual const std::string &Name() const = 0;
+  virtual void Start() = 0;
+  virtual void Stop() = 0;
+};
+
+struct StreamFormat {
+  size_t sample_rate = 48000;
+  size_t channels = 1;
+};
+
+// Pull based source of interleaved float samples. Not tied to a clock, so it
+// can be drained as fast as the analysis allows.
+class SampleReader {
+public:
+  virtual ~SampleReader() = default;
+  virtual StreamFormat Format() const = 0;
+  // Fills up to frames interleaved frames, returns 0 once the input ended.
+  virtual size_t Read(float *interleaved, size_t frames) = 0;
+};
+
+// A synthetic signal spec understood by SynthReader::FromSpec, or a path
+// handed to openAudioFile. duration_seconds only bounds synthetic signals,
+// raw_format only applies to headerless files.
+std::unique_ptr<SampleReader> openSampleReader(const std::string &spec,
+                                               StreamFormat raw_format,
+                                               float duration_seconds);
+
+} // namespace audio
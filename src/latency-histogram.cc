@@ -0,0 +1,89 @@
+#include "latency-histogram.h"
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+
+namespace audio {
+
+size_t LatencyHistogram::BucketOf(int64_t ns) {
+  uint64_t value = std::max<int64_t>(ns, 0) >> kMinShift;
+  if (value < (1u << kSubBucketBits))
+    return value;
+  // Octave from the top bit, sub-bucket from the next kSubBucketBits bits.
+  int octave = std::bit_width(value) - kSubBucketBits;
+  size_t sub = (value >> (octave - 1)) & ((1u << kSubBucketBits) - 1);
+  return std::min<size_t>((size_t(octave) << kSubBucketBits) + sub,
+                          kBuckets - 1);
+}
+
+int64_t LatencyHistogram::BucketUpperBound(size_t bucket) {
+  size_t octave = bucket >> kSubBucketBits;
+  size_t sub = bucket & ((1u << kSubBucketBits) - 1);
+  uint64_t value = octave == 0 ? sub + 1
+                               : ((1u << kSubBucketBits) + sub + 1)
+                                     << (octave - 1);
+  return int64_t(value) << kMinShift;
+}
+
+void LatencyHistogram::Record(int64_t ns) {
+  buckets_[BucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  int64_t max = max_.load(std::memory_order_relaxed);
+  while (ns > max &&
+         !max_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+  }
+}
+
+void LatencyHistogram::Reset() {
+  for (auto &bucket : buckets_)
+    bucket.store(0, std::memory_order_relaxed);
+  count_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
+
+int64_t LatencyHistogram::Percentile(double p) const {
+  uint64_t total = 0;
+  for (const auto &bucket : buckets_)
+    total += bucket.load(std::memory_order_relaxed);
+  if (total == 0)
+    return 0;
+  uint64_t rank = std::max<uint64_t>(1, uint64_t(total * p / 100.0 + 0.5));
+  uint64_t seen = 0;
+  for (size_t b = 0; b < kBuckets; ++b) {
+    seen += buckets_[b].load(std::memory_order_relaxed);
+    if (seen >= rank)
+      return std::min(BucketUpperBound(b), Max());
+  }
+  return Max();
+}
+
+void LatencyStats::Reset() {
+  audio_to_photon.Reset();
+  capture_to_fft.Reset();
+  fft.Reset();
+  publish_to_photon.Reset();
+}
+
+bool LatencyStats::DumpToFile(const std::string &path) const {
+  FILE *file = fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    perror(path.c_str());
+    return false;
+  }
+  fprintf(file, "%-18s %10s %10s %10s %10s\n", "stage", "count", "p50_us",
+          "p99_us", "max_us");
+  const std::pair<const char *, const LatencyHistogram *> stages[] = {
+      {"audio_to_photon", &audio_to_photon},
+      {"capture_to_fft", &capture_to_fft},
+      {"fft", &fft},
+      {"publish_to_photon", &publish_to_photon},
+  };
+  for (const auto &[name, histogram] : stages)
+    fprintf(file, "%-18s %10lu %10.1f %10.1f %10.1f\n", name,
+            histogram->Count(), histogram->Percentile(50) / 1e3,
+            histogram->Percentile(99) / 1e3, histogram->Max() / 1e3);
+  fclose(file);
+  return true;
+}
+
+} // namespace audio
@@ -0,0 +1,52 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace audio {
+
+// Log-linear histogram of durations, 8 sub-buckets per power of two from
+// 1 us to ~1 min (about 9% resolution). Record is wait-free and may be called
+// from any thread, reads are approximate while recording continues.
+class LatencyHistogram {
+public:
+  void Record(int64_t ns);
+  void Reset();
+
+  uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+  int64_t Max() const { return max_.load(std::memory_order_relaxed); }
+  // Upper bound of the bucket holding the p-th percentile, p in [0, 100].
+  int64_t Percentile(double p) const;
+
+private:
+  static constexpr int kSubBucketBits = 3;
+  static constexpr int kMinShift = 10; // ~1 us
+  static constexpr int kOctaves = 26;
+  static constexpr size_t kBuckets = (kOctaves + 1) << kSubBucketBits;
+
+  static size_t BucketOf(int64_t ns);
+  static int64_t BucketUpperBound(size_t bucket);
+
+  std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<int64_t> max_{0};
+};
+
+// The stages of one spectrum's way from the capture to the screen.
+struct LatencyStats {
+  // Capture of the newest sample in the window until the frame is shown.
+  LatencyHistogram audio_to_photon;
+  // Capture until the analysis thread starts the FFT (ring + STFT wait).
+  LatencyHistogram capture_to_fft;
+  LatencyHistogram fft;
+  // Publication until the frame is shown (render loop pickup + vsync).
+  LatencyHistogram publish_to_photon;
+
+  void Reset();
+  // Writes p50/p99/max of every stage, returns false if path is unwritable.
+  bool DumpToFile(const std::string &path) const;
+};
+
+} // namespace audio
@@ -0,0 +1,211 @@
+#include "loudness-meter.h"
+#include <algorithm>
+#include <cmath>
+
+namespace audio {
+namespace {
+float powerToDb(float power, float offset = 0.0f) {
+  if (!(power > 0.0f))
+    return LoudnessMeter::kFloorDb;
+  return std::max(offset + 10.0f * std::log10(power), LoudnessMeter::kFloorDb);
+}
+
+// Loudness of a mean square summed over channels, BS.1770 eq. 2.
+float loudness(float power) { return powerToDb(power, -0.691f); }
+} // namespace
+
+void LoudnessMeter::Reset() {
+  if (sample_rate_ != 0)
+    Configure(sample_rate_, channels_);
+}
+
+void LoudnessMeter::Restart() {
+  shelf_z1_ = shelf_z2_ = highpass_z1_ = highpass_z2_ = {};
+  history_ = {};
+  history_pos_ = 0;
+  block_fill_ = 0;
+  weighted_sum_ = plain_sum_ = {};
+  blocks_ = 0;
+}
+
+void LoudnessMeter::Configure(size_t sample_rate, size_t channels) {
+  *this = LoudnessMeter{};
+  sample_rate_ = sample_rate;
+  channels_ = channels;
+  block_size_ = std::max<size_t>(sample_rate / 10, 1);
+
+  // K-weighting as in BS.1770 Annex 1, re-derived for the sample rate (the
+  // published coefficients are for 48 kHz only).
+  const double rate = static_cast<double>(sample_rate);
+  {
+    const double f0 = 1681.974450955533;
+    const double gain_db = 3.999843853973347;
+    const double q = 0.7071752369554196;
+    const double k = std::tan(M_PI * f0 / rate);
+    const double vh = std::pow(10.0, gain_db / 20.0);
+    const double vb = std::pow(vh, 0.4996667741545416);
+    const double a0 = 1.0 + k / q + k * k;
+    shelf_ = {.b0 = float((vh + vb * k / q + k * k) / a0),
+              .b1 = float(2.0 * (k * k - vh) / a0),
+              .b2 = float((vh - vb * k / q + k * k) / a0),
+              .a1 = float(2.0 * (k * k - 1.0) / a0),
+              .a2 = float((1.0 - k / q + k * k) / a0)};
+  }
+  {
+    const double f0 = 38.13547087602444;
+    const double q = 0.5003270373238773;
+    const double k = std::tan(M_PI * f0 / rate);
+    const double a0 = 1.0 + k / q + k * k;
+    highpass_ = {.b0 = 1.0f,
+                 .b1 = -2.0f,
+                 .b2 = 1.0f,
+                 .a1 = float(2.0 * (k * k - 1.0) / a0),
+                 .a2 = float((1.0 - k / q + k * k) / a0)};
+  }
+
+  // Windowed sinc low-pass at the input Nyquist frequency, split into
+  // kPhases sub-filters. Each is normalised to unity gain at DC so a constant
+  // signal reads the same on every phase.
+  constexpr size_t taps = kTaps * kPhases;
+  constexpr double centre = (taps - 1) / 2.0;
+  for (size_t p = 0; p < kPhases; ++p) {
+    double sum = 0.0;
+    for (size_t k = 0; k < kTaps; ++k) {
+      size_t n = k * kPhases + p;
+      double x = (n - centre) / kPhases;
+      double sinc = std::sin(M_PI * x) / (M_PI * x);
+      double window = 0.5 * (1.0 - std::cos(2.0 * M_PI * (n + 0.5) / taps));
+      phases_[p][k] = float(sinc * window);
+      sum += phases_[p][k];
+    }
+    for (float &tap : phases_[p])
+      tap = float(tap / sum);
+  }
+}
+
+void LoudnessMeter::EndBlock() {
+  float weighted = 0.0f, plain = 0.0f;
+  for (size_t c = 0; c < channels_; ++c) {
+    weighted += weighted_sum_[c];
+    plain += plain_sum_[c];
+  }
+  weighted_blocks_[blocks_ % kBlocks] = weighted / block_size_;
+  plain_blocks_[blocks_ % kBlocks] = plain / (block_size_ * channels_);
+  blocks_++;
+  block_fill_ = 0;
+  weighted_sum_ = {};
+  plain_sum_ = {};
+
+  // Gating blocks are 400 ms long and start every 100 ms.
+  if (blocks_ < kMomentaryBlocks)
+    return;
+  float power = 0.0f;
+  for (size_t b = 0; b < kMomentaryBlocks; ++b)
+    power += weighted_blocks_[(blocks_ - 1 - b) % kBlocks];
+  float block_loudness = loudness(power / kMomentaryBlocks);
+  if (block_loudness < kHistogramMin)
+    return;
+  size_t bin = static_cast<size_t>((block_loudness - kHistogramMin) /
+                                   kHistogramStep);
+  bin = std::min(bin, kHistogramBins - 1);
+  histogram_[bin]++;
+  histogram_power_[bin] += power / kMomentaryBlocks;
+}
+
+float LoudnessMeter::IntegratedLoudness() const {
+  auto gatedMean = [&](size_t first_bin) {
+    double power = 0.0;
+    uint64_t count = 0;
+    for (size_t b = first_bin; b < kHistogramBins; ++b) {
+      power += histogram_power_[b];
+      count += histogram_[b];
+    }
+    return count == 0 ? 0.0f : float(power / count);
+  };
+
+  // Absolute gate (bins start at -70 LUFS), then the relative gate 10 LU
+  // below the loudness of what passed it.
+  float absolute = gatedMean(0);
+  if (absolute == 0.0f)
+    return kFloorDb;
+  float relative_gate = loudness(absolute) - 10.0f;
+  float first = std::ceil((relative_gate - kHistogramMin) / kHistogramStep);
+  return loudness(gatedMean(static_cast<size_t>(std::max(first, 0.0f))));
+}
+
+void LoudnessMeter::Process(const StftFrame &frame, size_t sample_rate,
+                            LevelInfo &levels) {
+  const size_t channels = std::min(frame.channel_count, kLanes);
+  if (channels == 0 || sample_rate == 0)
+    return;
+  if (sample_rate != sample_rate_ || channels != channels_)
+    Configure(sample_rate, channels);
+
+  const size_t n = frame.new_samples != 0
+                       ? std::min(frame.new_samples, frame.size)
+                       : frame.size;
+  const size_t offset = frame.size - n;
+  const size_t blocks_before = blocks_;
+  // Unused lanes stay zero throughout, every loop below runs over all of
+  // them so it has a constant trip count.
+  Lanes x{};
+  Lanes frame_peak{};
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t c = 0; c < channels; ++c)
+      x[c] = frame.channels[c][offset + i];
+
+    // K-weighting, both stages in transposed direct form II.
+    Lanes y;
+    for (size_t c = 0; c < kLanes; ++c) {
+      float s = shelf_.b0 * x[c] + shelf_z1_[c];
+      shelf_z1_[c] = shelf_.b1 * x[c] - shelf_.a1 * s + shelf_z2_[c];
+      shelf_z2_[c] = shelf_.b2 * x[c] - shelf_.a2 * s;
+      float h = highpass_.b0 * s + highpass_z1_[c];
+      highpass_z1_[c] = highpass_.b1 * s - highpass_.a1 * h + highpass_z2_[c];
+      highpass_z2_[c] = highpass_.b2 * s - highpass_.a2 * h;
+      y[c] = h;
+    }
+    for (size_t c = 0; c < kLanes; ++c) {
+      weighted_sum_[c] += y[c] * y[c];
+      plain_sum_[c] += x[c] * x[c];
+    }
+
+    // history_[history_pos_ + k] is the input k samples ago.
+    history_pos_ = (history_pos_ + kTaps - 1) % kTaps;
+    history_[history_pos_] = x;
+    history_[history_pos_ + kTaps] = x;
+    for (size_t p = 0; p < kPhases; ++p) {
+      Lanes acc{};
+      for (size_t k = 0; k < kTaps; ++k)
+        for (size_t c = 0; c < kLanes; ++c)
+          acc[c] += phases_[p][k] * history_[history_pos_ + k][c];
+      for (size_t c = 0; c < kLanes; ++c)
+        frame_peak[c] = std::max(frame_peak[c], std::abs(acc[c]));
+    }
+
+    if (++block_fill_ == block_size_)
+      EndBlock();
+  }
+
+  float peak = *std::max_element(frame_peak.begin(), frame_peak.end());
+  max_peak_ = std::max(max_peak_, peak);
+  levels.true_peak_dbtp = powerToDb(peak * peak);
+  levels.max_true_peak_dbtp = powerToDb(max_peak_ * max_peak_);
+
+  // Windows over the completed 100 ms blocks, shorter while starting up.
+  auto mean = [&](const std::array<float, kBlocks> &ring, size_t count) {
+    count = std::min(count, blocks_);
+    float sum = 0.0f;
+    for (size_t b = 0; b < count; ++b)
+      sum += ring[(blocks_ - 1 - b) % kBlocks];
+    return count == 0 ? 0.0f : sum / count;
+  };
+  levels.rms_dbfs = powerToDb(mean(plain_blocks_, kMomentaryBlocks));
+  levels.momentary_lufs = loudness(mean(weighted_blocks_, kMomentaryBlocks));
+  levels.short_term_lufs = loudness(mean(weighted_blocks_, kBlocks));
+  if (blocks_ != blocks_before)
+    integrated_ = IntegratedLoudness();
+  levels.integrated_lufs = integrated_;
+}
+
+} // namespace audio
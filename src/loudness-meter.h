@@ -0,0 +1,87 @@
+#pragma once
+#include "processed-audio.h"
+#include "stft.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace audio {
+
+// Time-domain level metering after ITU-R BS.1770-4 / EBU R128, fed the new
+// samples of every analysis frame so each captured sample is metered exactly
+// once. All channels are weighted 1 (no surround or LFE weighting).
+//
+// Samples go through the K-weighting filter (two biquads) and a 4x polyphase
+// true-peak interpolator with the channels in the lanes of one fixed-width
+// loop, which the compiler vectorises. Mean squares are accumulated in
+// 100 ms blocks: momentary loudness is the last 4, short-term the last 30,
+// and each 400 ms gating block lands in a 0.1 LU histogram that gives the
+// gated integrated loudness of any length of programme. Memory is fixed, cost
+// is O(samples).
+class LoudnessMeter {
+public:
+  // Reported for silence, instead of -inf.
+  static constexpr float kFloorDb = -120.0f;
+
+  // Meters the frame's new samples and writes the levels up to them. A
+  // change of sample rate or channel count starts over.
+  void Process(const StftFrame &frame, size_t sample_rate, LevelInfo &levels);
+  void Reset();
+  // The next frame does not follow on from the last one. Filters, true-peak
+  // history and the momentary and short-term windows start over, so no
+  // block spans the gap. Integrated loudness and the maximum true peak keep
+  // what was measured so far; the skipped audio is simply not in them.
+  void Restart();
+
+private:
+  static constexpr size_t kLanes = kMaxAnalysedChannels;
+  using Lanes = std::array<float, kLanes>;
+  // 100 ms blocks kept for the short-term window.
+  static constexpr size_t kBlocks = 30;
+  static constexpr size_t kMomentaryBlocks = 4;
+  // True-peak interpolator taps per phase.
+  static constexpr size_t kTaps = 12;
+  static constexpr size_t kPhases = 4;
+  // Gating blocks from -70 LUFS (the absolute gate) to +10 LUFS.
+  static constexpr float kHistogramMin = -70.0f;
+  static constexpr float kHistogramStep = 0.1f;
+  static constexpr size_t kHistogramBins = 800;
+
+  struct Biquad {
+    float b0, b1, b2, a1, a2;
+  };
+
+  // Starts over with filters designed for the rate.
+  void Configure(size_t sample_rate, size_t channels);
+  void EndBlock();
+  float IntegratedLoudness() const;
+
+  size_t sample_rate_ = 0;
+  size_t channels_ = 0;
+  Biquad shelf_{}, highpass_{};
+  // Transposed direct form II state, one lane per channel.
+  Lanes shelf_z1_{}, shelf_z2_{}, highpass_z1_{}, highpass_z2_{};
+
+  std::array<std::array<float, kTaps>, kPhases> phases_{};
+  // Input history, written twice so the newest kTaps rows are contiguous.
+  std::array<Lanes, 2 * kTaps> history_{};
+  size_t history_pos_ = 0;
+  float max_peak_ = 0.0f;
+
+  // The 100 ms block being accumulated.
+  size_t block_size_ = 0;
+  size_t block_fill_ = 0;
+  Lanes weighted_sum_{}, plain_sum_{};
+  // Completed blocks: K-weighted power summed over channels, unweighted power
+  // averaged over channels.
+  std::array<float, kBlocks> weighted_blocks_{};
+  std::array<float, kBlocks> plain_blocks_{};
+  size_t blocks_ = 0;
+  // Gating blocks per bin and the sum of their powers, so the gated mean is
+  // exact and the bins only decide which blocks pass the relative gate.
+  std::array<uint32_t, kHistogramBins> histogram_{};
+  std::array<double, kHistogramBins> histogram_power_{};
+  float integrated_ = kFloorDb;
+};
+
+} // namespace audio
@@ -1,207 +1,184 @@
+#include "analysis-scheduler.h"
 #include "audio-processor.h"
-#include "audio-stream.h"
+#include "capture-manager.h"
+#include "clock.h"
+#include "frame-pacer.h"
+#include "headless.h"
+#include "latency-histogram.h"
+#include "node-registry.h"
+#include "offline-render.h"
+#include "pipewire-session.h"
 #include "processed-audio.h"
 #include "raylib.h"
+#include "renderers.h"
 #include "rlImGui.h"
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <csignal>
 #include <cstddef>
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <functional>
 #include <imgui.h>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 static constexpr size_t sample_rate = 48000;
-static constexpr size_t buffer_size = 1 << 10;
+static constexpr size_t buffer_size = 1 << 12;
+// 75% overlap, a new spectrum every 1024 samples.
+static constexpr size_t hop_size = buffer_size / 4;
 static constexpr size_t frequency_count = buffer_size / 2 + 1;
-static constexpr size_t drawable_width = 400;
-
-struct BarOptions {
-  bool disabled = false;
-  float inbetween_gap = 0.0f;
-  float height_mult = 180.0f;
-  float min_height = 10.0f;
-  float anim_smoothness = 40.0f;
-  float hue_start = 180.0f;
-  float hue_dynamic_range = 180.f;
-  float pos_y_offset = 100.0f;
-  bool enable_changing_hue = true;
-  float changing_hue_speed = 10.0f;
-};
-
-struct CircleOptions {
-  bool disabled = false;
-  float radius_multiplier = 1.5f;
-  float max_outer_radius = 25.0f;
-  float anim_smoothness = 20.0f;
-  float hue_start = 300.0f;
-  float hue_dynamic_range = 1000.f;
-  bool enable_changing_hue = true;
-  float changing_hue_speed = 10.0f;
-  int segments = 100;
-  float start_angle_deg = 0.0f;
-  float end_angle_deg = 360.0f;
-};
 
-struct WaveOptions {
-  bool disabled = false;
-  float anim_smoothness = 20.0f;
-  float hue = 60.0f;
-  float pos_y_offset = 100.0f;
-  int wave_count = 3;
-  float damp_strength = 200.0f;
-  float x_movement_speed = 10.f;
-  float amplitude_mult = 30.0f;
-  float frequency_mult = 2.0f;
-  float thickness = 5.0f;
+struct AppOptions {
+  bool headless = false;
+  // Nodes captured for the main and the wave visualisations, see
+  // NodeSelector. Captured whenever they are present in the graph.
+  std::string source = "^Google Chrome$";
+  std::string source2 = "^rnnoise_source$";
+  // Matching nodes each of them captures at once. The oldest is drawn, all
+  // are analysed (and published).
+  size_t max_sources = 1;
+  // File or synthetic signal replacing the main capture.
+  std::string input;
+  audio::StreamFormat raw_format{.sample_rate = sample_rate, .channels = 1};
+  // Length of synthetic signals, 0 means endless (60 s when headless).
+  float seconds = 0.0f;
+  audio::StftOptions stft{.window_size = buffer_size, .hop_size = hop_size};
+  audio::FftOptions fft;
+  // Latency percentiles are written here on exit.
+  std::string latency_dump;
+  // Offline rendering to video frames instead of a live window.
+  std::string render_output;
+  audio::FrameFormat render_format = audio::FrameFormat::kRawRgba;
+  int render_fps = 60;
+  int render_width = 1000;
+  int render_height = 1000;
+  // Copy every analysis frame to shared memory for other processes, see
+  // shared-spectrum.h. publish_only does so without opening a window.
+  bool publish = false;
+  bool publish_only = false;
+  // Threads the captures' analysis shares, -1 is one per core less one and 0
+  // gives every capture a thread of its own.
+  int analysis_threads = -1;
 };
 
-void RenderBars(const audio::ProcessedAudioBuffer &audio_buffer,
-                BarOptions bar_options) {
-  if (bar_options.disabled)
-    return;
-  static float time;
-  time += GetFrameTime();
-  float start_x = (GetRenderWidth() - drawable_width) / 2.0f;
-  size_t bar_count = audio_buffer.squashed_samples.size();
-  float bar_width =
-      drawable_width / (2.0f * bar_count - 1) + bar_options.inbetween_gap;
-  static std::vector<float> rendered_bar_heights(bar_count);
-
-  for (int i = 0; i < bar_count; i++) {
-    float bar_height = bar_options.min_height;
-    if (audio_buffer.max_amplitude > 5.0f)
-      bar_height =
-          std::max(audio_buffer.squashed_samples[i].normalized_amplitude *
-                       bar_options.height_mult,
-                   bar_height);
-
-    rendered_bar_heights[i] += (bar_height - rendered_bar_heights[i]) *
-                               GetFrameTime() * bar_options.anim_smoothness;
-
-    bar_height = rendered_bar_heights[i];
-
-    float hue = bar_options.hue_start +
-                float(i) / bar_count * bar_options.hue_dynamic_range;
-
-    if (bar_options.enable_changing_hue)
-      hue += time * bar_options.changing_hue_speed;
-    float saturation = 1.0f;
-    float value = 1.0f;
-
-    Color color = ColorFromHSV(hue, saturation, value);
-
-    DrawRectangleRec(
-        {.x = start_x + 2 * i * bar_width,
-         .y = static_cast<float>((GetRenderHeight() - bar_height) / 2) -
-              bar_options.pos_y_offset,
-         .width = static_cast<float>(bar_width),
-         .height = static_cast<float>(bar_height)},
-        color);
-  }
+static void PrintUsage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [--headless] [--input FILE|sine:F1,F2|sweep:F0:F1:S|"
+          "noise|pink]\n"
+          "          [--seconds S] [--window N] [--hop N] [--rate HZ] "
+          "[--channels N]\n"
+          "          [--levels N] [--latency-dump FILE]\n"
+          "          [--render OUT [--png] [--fps N] [--size WxH]]\n"
+          "          [--publish | --publish-only] [--source RE] "
+          "[--source2 RE]\n"
+          "          [--max-sources N] [--analysis-threads N]\n"
+          "  --rate/--channels describe synthetic signals and raw float "
+          "files.\n"
+          "  --levels N analyses N octaves with multi-resolution FFTs.\n"
+          "  --render writes the --input as raw RGBA frames to OUT (- for "
+          "stdout),\n"
+          "    e.g. | ffmpeg -f rawvideo -pix_fmt rgba -s 1000x1000 -r 60 "
+          "-i - out.mp4\n"
+          "    With --png OUT is a pattern like frames/%%06d.png.\n"
+          "  --source/--source2 pick the nodes to capture by name, description "
+          "or\n"
+          "    application (regex), they are picked up whenever they appear.\n"
+          "  --max-sources N captures up to N matching nodes per selector at "
+          "once,\n"
+          "    only the first is drawn.\n"
+          "  --publish shares the analysis of every source in shared memory,\n"
+          "    --publish-only does so until interrupted, without a window.\n"
+          "  --analysis-threads N analyses all sources on N shared threads, "
+          "0 gives\n"
+          "    each source its own thread.\n",
+          argv0);
 }
 
-void RenderCircle(const audio::ProcessedAudioBuffer &audio_buffer,
-                  CircleOptions circle_options) {
-  if (circle_options.disabled)
-    return;
-  static float time;
-  time += GetFrameTime();
-  Vector2 center = {.x = GetRenderWidth() / 2.0f,
-                    .y = GetRenderHeight() / 2.0f};
-  float radius = (drawable_width * circle_options.radius_multiplier / 2.0f);
-  float outer_radius = radius + std::max(audio_buffer.avg_amplitude *
-                                             circle_options.max_outer_radius,
-                                         1.0f);
-  static float rendered_radius = 0.0f;
-  rendered_radius += (outer_radius - rendered_radius) * GetFrameTime() *
-                     circle_options.anim_smoothness;
-  float hue = circle_options.hue_start +
-              circle_options.hue_dynamic_range *
-                  (audio_buffer.avg_amplitude / audio_buffer.max_amplitude);
-
-  if (circle_options.enable_changing_hue)
-    hue += time * circle_options.changing_hue_speed;
-
-  float saturation = 1.0f;
-  float value = 1.0f;
-  Color color = ColorFromHSV(hue, saturation, value);
-  DrawRing(center, radius, rendered_radius, circle_options.start_angle_deg,
-           circle_options.end_angle_deg, circle_options.segments, color);
-}
-
-std::vector<audio::ProcessedAudioSample>
-maxKElements(const audio::ProcessedAudioBuffer &audio_buffer, int K) {
-  std::vector<audio::ProcessedAudioSample> topKElements(K);
-
-  for (auto sample : audio_buffer.samples) {
-    auto pos = std::find_if(topKElements.begin(), topKElements.end(),
-                            [sample](audio::ProcessedAudioSample x) {
-                              return sample.normalized_amplitude >
-                                     x.normalized_amplitude;
-                            });
-
-    if (pos != topKElements.end()) {
-      std::copy_backward(pos, topKElements.end() - 1, topKElements.end());
-      *pos = sample;
+static bool ParseArgs(int argc, char **argv, AppOptions &options) {
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+    auto takes_value = [&](const char *name) {
+      if (std::strcmp(arg, name) != 0)
+        return false;
+      if (value == nullptr) {
+        fprintf(stderr, "%s needs a value\n", name);
+        return false;
+      }
+      ++i;
+      return true;
+    };
+
+    if (std::strcmp(arg, "--headless") == 0)
+      options.headless = true;
+    else if (takes_value("--input"))
+      options.input = value;
+    else if (takes_value("--seconds"))
+      options.seconds = std::strtof(value, nullptr);
+    else if (takes_value("--window"))
+      options.stft.window_size = std::strtoul(value, nullptr, 10);
+    else if (takes_value("--hop"))
+      options.stft.hop_size = std::strtoul(value, nullptr, 10);
+    else if (takes_value("--rate"))
+      options.raw_format.sample_rate = std::strtoul(value, nullptr, 10);
+    else if (takes_value("--channels")) {
+      // Used as a stride and divisor by the readers, 0 must not get through.
+      char *end = nullptr;
+      long channels = std::strtol(value, &end, 10);
+      if (end == value || *end != '\0' || channels < 1) {
+        fprintf(stderr, "--channels wants a count of at least 1\n");
+        return false;
+      }
+      options.raw_format.channels = channels;
     }
-  }
-
-  return topKElements;
-}
-
-void RenderWave(const audio::ProcessedAudioBuffer &audio_buffer,
-                WaveOptions wave_options) {
-  if (wave_options.disabled)
-    return;
-  float start_x = (GetRenderWidth() - drawable_width) / 2.0f;
-  static float time = 0.0f;
-  int max_elements = wave_options.wave_count;
-  auto max_components = maxKElements(audio_buffer, max_elements);
-
-  std::array<Vector2, drawable_width> points{0};
-
-  static std::array<Vector2, drawable_width> rendered_points{
-      GetRenderHeight() / 2.0f + wave_options.pos_y_offset};
-
-  const float damp_region = wave_options.damp_strength;
-  time += GetFrameTime();
-
-  for (int i = 0; i < drawable_width; i++) {
-    for (auto &sample : max_components) {
-      const float angularFrequency =
-          -2.0f * PI * sample.frequency * wave_options.frequency_mult;
-      float y = wave_options.amplitude_mult * sample.normalized_amplitude *
-                sinf(i * angularFrequency / sample_rate +
-                     time * wave_options.x_movement_speed);
-
-      if (i < drawable_width / 2) {
-        points[i].y += y * std::min(i / damp_region, 1.0f);
-      } else {
-        points[i].y += y * std::min((drawable_width - i) / damp_region, 1.0f);
+    else if (takes_value("--levels"))
+      options.fft.resolution_levels = std::strtoul(value, nullptr, 10);
+    else if (takes_value("--latency-dump"))
+      options.latency_dump = value;
+    else if (takes_value("--render"))
+      options.render_output = value;
+    else if (takes_value("--source"))
+      options.source = value;
+    else if (takes_value("--source2"))
+      options.source2 = value;
+    else if (takes_value("--max-sources")) {
+      char *end = nullptr;
+      long sources = std::strtol(value, &end, 10);
+      if (end == value || *end != '\0' || sources < 1) {
+        fprintf(stderr, "--max-sources wants a count of at least 1\n");
+        return false;
       }
-
-      points[i].x = start_x + i;
+      options.max_sources = sources;
+    }
+    else if (takes_value("--analysis-threads"))
+      options.analysis_threads = std::atoi(value);
+    else if (std::strcmp(arg, "--publish") == 0)
+      options.publish = true;
+    else if (std::strcmp(arg, "--publish-only") == 0)
+      options.publish_only = true;
+    else if (std::strcmp(arg, "--png") == 0)
+      options.render_format = audio::FrameFormat::kPng;
+    else if (takes_value("--fps"))
+      options.render_fps = std::atoi(value);
+    else if (takes_value("--size")) {
+      if (std::sscanf(value, "%dx%d", &options.render_width,
+                      &options.render_height) != 2) {
+        fprintf(stderr, "--size wants WxH\n");
+        return false;
+      }
+    }
+    else {
+      PrintUsage(argv[0]);
+      return false;
     }
   }
-
-  Vector2 last_point = {
-      .x = start_x, .y = GetRenderHeight() / 2.0f + wave_options.pos_y_offset};
-
-  for (int i = 0; i < points.size(); i++) {
-    rendered_points[i].x = start_x + i;
-
-    rendered_points[i].y += (points[i].y - rendered_points[i].y) *
-                            GetFrameTime() * wave_options.anim_smoothness;
-    Vector2 current_point = {.x = rendered_points[i].x,
-                             .y = GetRenderHeight() / 2.0f +
-                                  wave_options.pos_y_offset +
-                                  rendered_points[i].y};
-
-    DrawLineEx(last_point, current_point, wave_options.thickness,
-               ColorFromHSV(wave_options.hue, 1.0f, 1.0f));
-    last_point = current_point;
-  }
+  return true;
 }
 
 void RenderBarOptionConfigurator(BarOptions &bar_options) {
@@ -209,6 +186,9 @@ void RenderBarOptionConfigurator(BarOptions &bar_options) {
                                // append into it.
 
   ImGui::Checkbox("disabled", &bar_options.disabled);
+  ImGui::Checkbox("gpu", &bar_options.gpu);
+  if (bar_options.gpu)
+    ImGui::SliderFloat("gradient", &bar_options.gradient, 0.0f, 1.0f);
   ImGui::SliderFloat("inbetween_gap", &bar_options.inbetween_gap, 0.0f, 10.0f);
   ImGui::SliderFloat("height_mult", &bar_options.height_mult, 50.0f, 400.0f);
   ImGui::SliderFloat("min_height", &bar_options.min_height, 0.0f, 100.f);
@@ -230,7 +210,8 @@ void RenderBarOptionConfigurator(BarOptions &bar_options) {
   ImGui::End();
 }
 
-void RenderCircleOptionConfigurator(CircleOptions &circle_options) {
+void RenderCircleOptionConfigurator(CircleOptions &circle_options,
+                                    const audio::BeatInfo &beat) {
 
   ImGui::Begin("Circle options"); // Create a window called "Hello, world!" and
   ImGui::Checkbox("disabled", &circle_options.disabled);
@@ -248,6 +229,12 @@ void RenderCircleOptionConfigurator(CircleOptions &circle_options) {
                      270.0f);
   ImGui::SliderFloat("end_angle_deg", &circle_options.end_angle_deg, 90.0f,
                      540.0f);
+  ImGui::Text("tempo %.1f bpm, %lu onsets, %lu beats", beat.bpm, beat.onsets,
+              beat.beats);
+  ImGui::Checkbox("pulse_on_beat", &circle_options.pulse_on_beat);
+  if (circle_options.pulse_on_beat)
+    ImGui::SliderFloat("pulse_decay", &circle_options.pulse_decay, 1.0f,
+                       20.0f);
   ImGui::Checkbox("enable_changing_hue", &circle_options.enable_changing_hue);
   if (circle_options.enable_changing_hue) {
 
@@ -275,7 +262,8 @@ void RenderWaveOptionConfigurator(WaveOptions &wave_options) {
                      100.f);
   ImGui::SliderFloat("amplitude_mult", &wave_options.amplitude_mult, 1.0f,
                      100.f);
-  ImGui::SliderInt("wave_count", &wave_options.wave_count, 1, 10);
+  ImGui::SliderInt("wave_count", &wave_options.wave_count, 1, 32);
+  ImGui::Checkbox("interpolate_peaks", &wave_options.interpolate_peaks);
   ImGui::SliderFloat("frequency_mult", &wave_options.frequency_mult, 1.0f,
                      10.0f);
   ImGui::SliderFloat("thickness", &wave_options.thickness, 1.0f, 20.0f);
@@ -283,36 +271,269 @@ void RenderWaveOptionConfigurator(WaveOptions &wave_options) {
   ImGui::End();
 }
 
-int main() {
-  audio::AudioProcessor processor1("Test", sample_rate, buffer_size);
-  audio::AudioProcessor processor2("Test", sample_rate, buffer_size);
-  Visualizer::AudioStream audio_stream(
-      "Google Chrome", sample_rate, buffer_size,
-      [&](std::vector<float> samples, size_t sample_rate) {
-        processor1.OnNewSample(std::move(samples));
-      });
-
-  Visualizer::AudioStream audio_stream2(
-      "rnnoise_source", sample_rate / 2, buffer_size / 2,
-      [&](std::vector<float> samples, size_t sample_rate) {
-        processor2.OnNewSample(std::move(samples));
-      });
+void RenderSpectrogramOptionConfigurator(
+    SpectrogramOptions &spectrogram_options) {
+  ImGui::Begin("Spectrogram options");
+  ImGui::Checkbox("disabled", &spectrogram_options.disabled);
+  ImGui::SliderInt("history", &spectrogram_options.history, 64, 4096);
+  ImGui::Checkbox("raw_bins", &spectrogram_options.raw_bins);
+  if (spectrogram_options.raw_bins)
+    ImGui::SliderInt("max_bin", &spectrogram_options.max_bin, 16,
+                     static_cast<int>(frequency_count - 1));
+  ImGui::SliderFloat("db_range", &spectrogram_options.db_range, 20.0f,
+                     120.0f);
+  ImGui::SliderFloat("height", &spectrogram_options.height, 50.0f, 1000.0f);
+  ImGui::End();
+}
+
+struct PacingOptions {
+  audio::FramePacerOptions pacer;
+  // Drop to idle_fps after idle_after_s of silence, back on the first sound.
+  bool low_power = true;
+  int idle_fps = 10;
+  float idle_after_s = 2.0f;
+  // Peak spectrum level counted as silence, the bars' own cut-off.
+  float silence_level = 5.0f;
+};
+
+void RenderPacingConfigurator(PacingOptions &pacing, bool idle) {
+  ImGui::Begin("Pacing");
+  ImGui::Text("%d fps%s", GetFPS(), idle ? " (idle)" : "");
+  ImGui::Checkbox("interpolate", &pacing.pacer.interpolate);
+  ImGui::Checkbox("low_power", &pacing.low_power);
+  if (pacing.low_power) {
+    ImGui::SliderInt("idle_fps", &pacing.idle_fps, 1, 30);
+    ImGui::SliderFloat("idle_after_s", &pacing.idle_after_s, 0.5f, 10.0f);
+    ImGui::SliderFloat("silence_level", &pacing.silence_level, 0.0f, 20.0f);
+  }
+  ImGui::End();
+}
+
+// Switches between the display rate and the idle rate, returns whether idle.
+static bool UpdateIdle(const PacingOptions &pacing, float max_amplitude,
+                       float &silent_s, bool idle) {
+  if (max_amplitude > pacing.silence_level)
+    silent_s = 0.0f;
+  else
+    silent_s += GetFrameTime();
+  const bool want_idle = pacing.low_power && silent_s >= pacing.idle_after_s;
+  if (want_idle != idle)
+    // 0 leaves pacing to vsync.
+    SetTargetFPS(want_idle ? pacing.idle_fps : 0);
+  return want_idle;
+}
+
+static void RenderLatencyRow(const char *name,
+                             const audio::LatencyHistogram &histogram) {
+  ImGui::Text("%-18s p50 %6.2f  p99 %6.2f  max %6.2f ms", name,
+              histogram.Percentile(50) / 1e6, histogram.Percentile(99) / 1e6,
+              histogram.Max() / 1e6);
+}
+
+void RenderLatencyPanel(audio::LatencyStats &stats,
+                        const std::string &dump_path) {
+  ImGui::Begin("Latency");
+  ImGui::Text("%lu frames", stats.audio_to_photon.Count());
+  RenderLatencyRow("audio to photon", stats.audio_to_photon);
+  RenderLatencyRow("capture to fft", stats.capture_to_fft);
+  RenderLatencyRow("fft", stats.fft);
+  RenderLatencyRow("publish to photon", stats.publish_to_photon);
+  if (ImGui::Button("Reset"))
+    stats.Reset();
+  if (!dump_path.empty()) {
+    ImGui::SameLine();
+    if (ImGui::Button("Dump"))
+      stats.DumpToFile(dump_path);
+  }
+  ImGui::End();
+}
+
+void RenderLevelsPanel(const audio::LevelInfo &levels) {
+  ImGui::Begin("Levels");
+  ImGui::Text("momentary   %6.1f LUFS", levels.momentary_lufs);
+  ImGui::Text("short term  %6.1f LUFS", levels.short_term_lufs);
+  ImGui::Text("integrated  %6.1f LUFS", levels.integrated_lufs);
+  ImGui::Text("rms         %6.1f dBFS", levels.rms_dbfs);
+  ImGui::Text("true peak   %6.1f dBTP (max %.1f)", levels.true_peak_dbtp,
+              levels.max_true_peak_dbtp);
+  ImGui::End();
+}
+
+// Every audio node of the graph, the captured ones marked with the view
+// showing them.
+void RenderSourcesPanel(const std::vector<Visualizer::AudioNode> &nodes,
+                        const Visualizer::CaptureManager &captures1,
+                        const Visualizer::CaptureManager &captures2) {
+  ImGui::Begin("Sources");
+  for (const auto &node : nodes) {
+    const char *mark = captures1.IsCaptured(node)   ? "main"
+                       : captures2.IsCaptured(node) ? "wave"
+                                                    : "";
+    ImGui::Text("%4u %-4s %-20s %s", node.id, mark, node.media_class.c_str(),
+                node.description.empty() ? node.name.c_str()
+                                         : node.description.c_str());
+  }
+  ImGui::End();
+}
+
+// Called once the frame showing `frame` has been swapped in, every spectrum
+// is counted once however many frames it stays on screen. display_ns is the
+// capture time of the audio actually drawn (see FramePacer::DisplayTimeNs),
+// which trails the newest frame while interpolating.
+static void RecordLatency(const audio::FrameTiming &frame, int64_t display_ns,
+                          int64_t &last_publish_ns,
+                          audio::LatencyStats &stats) {
+  if (frame.publish_ns == 0 || frame.publish_ns == last_publish_ns)
+    return;
+  last_publish_ns = frame.publish_ns;
+  int64_t shown_ns = audio::monotonicNs();
+  stats.fft.Record(frame.fft_end_ns - frame.fft_start_ns);
+  stats.publish_to_photon.Record(shown_ns - frame.publish_ns);
+  if (frame.capture_ns == 0)
+    return;
+  stats.capture_to_fft.Record(frame.fft_start_ns - frame.capture_ns);
+  stats.audio_to_photon.Record(
+      shown_ns - (display_ns != 0 ? display_ns : frame.capture_ns));
+}
+
+static std::atomic<bool> interrupted{false};
+
+// Keeps the sources running until SIGINT or SIGTERM, for --publish-only.
+// on_tick runs every 100 ms.
+static void WaitForInterrupt(const std::function<void()> &on_tick) {
+  auto on_signal = [](int) { interrupted.store(true); };
+  std::signal(SIGINT, on_signal);
+  std::signal(SIGTERM, on_signal);
+  while (!interrupted.load()) {
+    on_tick();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+}
+
+int main(int argc, char **argv) {
+  AppOptions options;
+  if (!ParseArgs(argc, argv, options))
+    return 1;
+
+  if (options.headless) {
+    return audio::runHeadless(
+        {.input = options.input.empty() ? "sine:440" : options.input,
+         .raw_format = options.raw_format,
+         .seconds = options.seconds > 0 ? options.seconds : 60.0f,
+         .stft = options.stft,
+         .fft = options.fft});
+  }
+
+  if (!options.render_output.empty()) {
+    if (options.input.empty()) {
+      fprintf(stderr, "--render needs an --input\n");
+      return 1;
+    }
+    return audio::runOfflineRender(
+        {.input = options.input,
+         .raw_format = options.raw_format,
+         .seconds = options.seconds > 0 ? options.seconds : 10.0f,
+         .stft = options.stft,
+         .fft = options.fft,
+         .output = options.render_output,
+         .format = options.render_format,
+         .fps = options.render_fps,
+         .width = options.render_width,
+         .height = options.render_height});
+  }
+
+  std::unique_ptr<audio::SampleReader> reader;
+  if (!options.input.empty()) {
+    reader = audio::openSampleReader(options.input, options.raw_format,
+                                     options.seconds);
+    if (!reader)
+      return 1;
+  }
+
+  const bool publish = options.publish || options.publish_only;
+  Visualizer::PipewireSession session;
+  Visualizer::NodeRegistry registry(session);
+  // Outlives the captures analysed on it.
+  std::unique_ptr<audio::AnalysisScheduler> scheduler;
+  audio::AnalysisWorkerOptions worker_options;
+  if (options.analysis_threads != 0) {
+    scheduler = std::make_unique<audio::AnalysisScheduler>(
+        audio::AnalysisSchedulerOptions{
+            .threads = size_t(std::max(options.analysis_threads, 0))});
+    // A source the pool falls behind on skips ahead rather than lagging.
+    worker_options = {.scheduler = scheduler.get(), .max_backlog_hops = 4};
+  }
+  Visualizer::CaptureManager captures1(
+      session, {.selector = Visualizer::NodeSelector(options.source),
+                .max_sources = options.max_sources,
+                .sample_rate = sample_rate,
+                .stft = options.stft,
+                .fft = options.fft,
+                .worker = worker_options,
+                .publish = publish});
+  Visualizer::CaptureManager captures2(
+      session,
+      {.selector = Visualizer::NodeSelector(options.source2),
+       .max_sources = options.max_sources,
+       .sample_rate = sample_rate / 2,
+       .stft = {.window_size = buffer_size / 2, .hop_size = hop_size / 2},
+       .worker = worker_options,
+       .publish = publish,
+       .publish_role = "source2"});
+  if (reader)
+    captures1.AttachReader(options.input, std::move(reader));
+
+  // Follows the graph: attaches and detaches captures as nodes come and go.
+  std::vector<Visualizer::AudioNode> nodes;
+  uint64_t nodes_generation = 0;
+  auto update_sources = [&] {
+    const uint64_t generation = registry.Generation();
+    if (generation == nodes_generation)
+      return;
+    nodes_generation = generation;
+    nodes = registry.Nodes();
+    captures1.Reconcile(nodes);
+    captures2.Reconcile(nodes);
+  };
+
+  if (options.publish_only) {
+    WaitForInterrupt(update_sources);
+    return 0;
+  }
 
   BarOptions bar_options;
   CircleOptions circle_options;
   WaveOptions wave_options;
+  SpectrogramOptions spectrogram_options;
+  PacingOptions pacing;
+  audio::FramePacer pacer1(pacing.pacer);
+  audio::FramePacer pacer2(pacing.pacer);
+  float silent_s = 0.0f;
+  bool idle = false;
+  audio::LatencyStats latency;
+  int64_t last_publish_ns = 0;
 
   SetConfigFlags(FLAG_MSAA_4X_HINT | FLAG_VSYNC_HINT | FLAG_WINDOW_RESIZABLE);
   InitWindow(1000, 1000, "Example");
-  audio_stream.Start();
-  audio_stream2.Start();
   bool show_imgui = false;
 
   rlImGuiSetup(true);
 
   while (!WindowShouldClose()) {
-    const auto &buffer = processor1.Buffer();
-    const auto &buffer2 = processor2.Buffer();
+    update_sources();
+    const auto &frame = captures1.Frame();
+    const int64_t now_ns = audio::monotonicNs();
+    pacer1.SetOptions(pacing.pacer);
+    pacer2.SetOptions(pacing.pacer);
+    pacer1.Push(frame, now_ns);
+    pacer2.Push(captures2.Frame(), now_ns);
+    // Blends of the analysis frames around the display time, only recomputed
+    // when they would change.
+    const auto &buffer = pacer1.Spectrum(now_ns);
+    const auto &buffer2 = pacer2.Spectrum(now_ns);
+    idle = UpdateIdle(pacing, std::max(buffer.max_amplitude,
+                                       buffer2.max_amplitude),
+                      silent_s, idle);
 
     if (IsKeyPressed(KEY_C)) {
       show_imgui = !show_imgui;
@@ -323,18 +544,28 @@ int main() {
     if (show_imgui) {
       rlImGuiBegin();
       RenderBarOptionConfigurator(bar_options);
-      RenderCircleOptionConfigurator(circle_options);
+      RenderCircleOptionConfigurator(circle_options, frame.beat);
       RenderWaveOptionConfigurator(wave_options);
+      RenderSpectrogramOptionConfigurator(spectrogram_options);
+      RenderLatencyPanel(latency, options.latency_dump);
+      RenderLevelsPanel(frame.levels);
+      RenderSourcesPanel(nodes, captures1, captures2);
+      RenderPacingConfigurator(pacing, idle);
       rlImGuiEnd();
     }
 
-    RenderBars(buffer, bar_options);
-    RenderCircle(buffer, circle_options);
-    RenderWave(buffer2, wave_options);
+    RenderSpectrogram(frame, spectrogram_options);
+    RenderBars(buffer, bar_options, pacer1.Changed());
+    RenderCircle(buffer, frame.beat, circle_options);
+    RenderWave(buffer2, wave_options, pacer2.Changed());
     EndDrawing();
+    RecordLatency(frame.timing, pacer1.DisplayTimeNs(), last_publish_ns,
+                  latency);
   }
-  audio_stream.Stop();
-  audio_stream2.Stop();
+  if (!options.latency_dump.empty())
+    latency.DumpToFile(options.latency_dump);
+  UnloadBarRenderer();
+  UnloadSpectrogramRenderer();
   rlImGuiShutdown(); // cleans up ImGui
   CloseWindow();
 }
@@ -0,0 +1,266 @@
+#include "multi-resolution.h"
+#include "frequency-table.h"
+#include "simd-kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace audio {
+namespace {
+
+using HalfbandTaps = std::array<float, (HalfbandDecimator::kCenter + 1) / 2>;
+
+// Non-zero taps next to the 0.5 centre tap: taps[p] weighs the two inputs
+// 2p + 1 away from the centre. Blackman windowed ideal half-band response.
+const HalfbandTaps &halfbandTaps() {
+  static const HalfbandTaps taps = [] {
+    constexpr size_t center = HalfbandDecimator::kCenter;
+    constexpr size_t length = HalfbandDecimator::kTaps;
+    HalfbandTaps g{};
+    double sum = 0.0;
+    for (size_t p = 0; p < g.size(); ++p) {
+      const double distance = 2.0 * p + 1.0;
+      const double n = center + distance;
+      const double blackman = 0.42 - 0.5 * std::cos(2 * M_PI * n / (length - 1)) +
+                              0.08 * std::cos(4 * M_PI * n / (length - 1));
+      g[p] = std::sin(M_PI * distance / 2) / (M_PI * distance) * blackman;
+      sum += g[p];
+    }
+    // Unity gain at DC together with the centre tap.
+    for (float &tap : g)
+      tap = static_cast<float>(tap * 0.25 / sum);
+    return g;
+  }();
+  return taps;
+}
+
+// Fraction of a level's FFT size where it hands over to the level below,
+// 0.4 of its Nyquist frequency. Twice that is the top of the level below.
+size_t crossoverBin(size_t window_size) { return window_size / 5; }
+
+size_t activeLevels(size_t window_size, size_t levels) {
+  if (crossoverBin(window_size) == 0)
+    return 1;
+  return std::clamp<size_t>(levels, 1, MultiResolutionAnalyzer::kMaxLevels);
+}
+
+} // namespace
+
+size_t HalfbandDecimator::Process(const float *in, size_t count, float *out) {
+  const HalfbandTaps &taps = halfbandTaps();
+  size_t produced = 0;
+  for (size_t i = 0; i < count; ++i) {
+    delay_[pos_] = in[i];
+    delay_[pos_ + kTaps] = in[i];
+    if (++pos_ == kTaps)
+      pos_ = 0;
+    odd_ = !odd_;
+    if (odd_)
+      continue;
+    // Oldest to newest input.
+    const float *w = delay_.data() + pos_;
+    float acc = 0.5f * w[kCenter];
+    for (size_t p = 0; p < taps.size(); ++p)
+      acc += taps[p] * (w[kCenter - 2 * p - 1] + w[kCenter + 2 * p + 1]);
+    out[produced++] = acc;
+  }
+  return produced;
+}
+
+MultiResolutionAnalyzer::MultiResolutionAnalyzer(size_t levels)
+    : requested_levels_(levels) {}
+
+size_t MultiResolutionAnalyzer::BinCount(size_t window_size, size_t levels) {
+  levels = activeLevels(window_size, levels);
+  const size_t out_size = window_size / 2 + 1;
+  if (levels == 1)
+    return out_size;
+  const size_t crossover = crossoverBin(window_size);
+  // Deepest level from DC, the middle ones one crossover each, level 0 the
+  // rest up to Nyquist.
+  return 2 * crossover + (levels - 2) * crossover + (out_size - crossover);
+}
+
+void MultiResolutionAnalyzer::Reconfigure(size_t window_size, size_t channels,
+                                          size_t sample_rate) {
+  window_size_ = window_size;
+  channels_ = channels;
+  sample_rate_ = sample_rate;
+  levels_ = activeLevels(window_size, requested_levels_);
+
+  const size_t rows = channels + 2;
+  const size_t out_size = window_size / 2 + 1;
+  decimated_.assign(rows * (levels_ - 1), Level{});
+  for (Level &level : decimated_)
+    level.history.assign(2 * window_size, 0.0f);
+
+  segments_.clear();
+  std::vector<float> bin_frequencies;
+  const uint32_t crossover = crossoverBin(window_size);
+  for (size_t level = levels_; level-- > 0;) {
+    Segment segment{.level = static_cast<uint32_t>(level),
+                    .first_bin = level == levels_ - 1 ? 0 : crossover,
+                    .last_bin = level == 0 ? static_cast<uint32_t>(out_size)
+                                           : 2 * crossover};
+    segments_.push_back(segment);
+    const float bin_width =
+        static_cast<float>(sample_rate) / (window_size << level);
+    for (uint32_t bin = segment.first_bin; bin < segment.last_bin; ++bin)
+      bin_frequencies.push_back(bin * bin_width);
+  }
+  bin_frequencies_ = sharedFrequencyTable(std::move(bin_frequencies));
+  band_map_.reset();
+
+  in_ = allocFftwfReal(rows * levels_ * window_size);
+  out_ = allocFftwfComplex(rows * levels_ * out_size);
+  mid_.resize(window_size);
+  side_.resize(window_size);
+  for (auto &fresh : fresh_)
+    fresh.resize(window_size / 2 + 1);
+}
+
+void MultiResolutionAnalyzer::Restart() {
+  for (Level &level : decimated_) {
+    level.decimator = HalfbandDecimator{};
+    std::fill(level.history.begin(), level.history.end(), 0.0f);
+    level.write_pos = 0;
+  }
+}
+
+void MultiResolutionAnalyzer::Process(const StftFrame &frame,
+                                      size_t sample_rate,
+                                      ProcessedAudioFrame &output,
+                                      const FftOptions &options) {
+  const size_t n = frame.size;
+  const size_t channels = std::min(frame.channel_count, kMaxAnalysedChannels);
+  if (n != window_size_ || channels != channels_ ||
+      sample_rate != sample_rate_)
+    Reconfigure(n, channels, sample_rate);
+  else if (frame.discontinuity)
+    Restart();
+
+  const size_t rows = channels + 2;
+  const size_t out_size = n / 2 + 1;
+  const std::vector<float> &window = hannWindow(n);
+  const Kernels &k = kernels();
+
+  // The decimators need the unwindowed mid and side signals.
+  const float mid_scale = 1.0f / channels;
+  for (size_t i = 0; i < n; ++i) {
+    float acc = 0.0f;
+    for (size_t c = 0; c < channels; ++c)
+      acc += frame.channels[c][i];
+    mid_[i] = acc * mid_scale;
+  }
+  for (size_t i = 0; i < n; ++i)
+    side_[i] =
+        channels >= 2 ? (frame.channels[0][i] - frame.channels[1][i]) * 0.5f
+                      : 0.0f;
+
+  const size_t new_samples =
+      frame.new_samples != 0 ? std::min(frame.new_samples, n) : n;
+  for (size_t r = 0; r < rows; ++r) {
+    const float *signal = r < channels    ? frame.channels[r]
+                          : r == channels ? mid_.data()
+                                          : side_.data();
+    float *in = in_.get() + r * levels_ * n;
+    k.window_multiply(signal, window.data(), in, n);
+
+    const float *fresh = signal + n - new_samples;
+    size_t fresh_count = new_samples;
+    for (size_t level = 1; level < levels_; ++level) {
+      Level &state = decimated_[r * (levels_ - 1) + level - 1];
+      float *decimated = fresh_[level % 2].data();
+      fresh_count = state.decimator.Process(fresh, fresh_count, decimated);
+      for (size_t i = 0; i < fresh_count; ++i) {
+        state.history[state.write_pos] = decimated[i];
+        state.history[state.write_pos + n] = decimated[i];
+        if (++state.write_pos == n)
+          state.write_pos = 0;
+      }
+      k.window_multiply(state.history.data() + state.write_pos,
+                        window.data(), in + level * n, n);
+      fresh = decimated;
+    }
+  }
+
+  // Every level of every row in one batched plan.
+  fftwf_execute_dft_r2c(
+      FftPlanCache::Instance().RealToComplexF(n, rows * levels_), in_.get(),
+      out_.get());
+
+  BandMapKey key{.fft_size = n,
+                 .sample_rate = sample_rate,
+                 .scale = options.band_scale,
+                 .band_count = options.band_count,
+                 .max_frequency = static_cast<float>(options.max_frequency),
+                 .reduction = options.band_reduction};
+  if (!band_map_ || key != band_map_key_) {
+    band_map_ =
+        std::make_unique<BandMap>(BandMap::BuildForBins(
+            key, {bin_frequencies_.begin(), bin_frequencies_.end()}));
+    band_map_key_ = key;
+  }
+
+  output.channel_count = channels;
+  for (size_t c = 0; c < channels; ++c)
+    FillBuffer(out_.get() + c * levels_ * out_size, output.channels[c],
+               options);
+  FillBuffer(out_.get() + channels * levels_ * out_size, output.mid, options);
+  FillBuffer(out_.get() + (channels + 1) * levels_ * out_size, output.side,
+             options);
+}
+
+void MultiResolutionAnalyzer::FillBuffer(const fftwf_complex *out,
+                                         ProcessedAudioBuffer &output,
+                                         const FftOptions &options) {
+  const size_t out_size = window_size_ / 2 + 1;
+  const Kernels &k = kernels();
+  const size_t total = bin_frequencies_.size();
+  output.magnitudes.resize(total);
+  float *magnitudes = output.magnitudes.data();
+
+  size_t offset = 0;
+  for (const Segment &segment : segments_) {
+    const size_t count = segment.last_bin - segment.first_bin;
+    k.complex_magnitude(&out[segment.level * out_size + segment.first_bin][0],
+                        magnitudes + offset, count);
+    offset += count;
+  }
+
+  const size_t count =
+      std::upper_bound(bin_frequencies_.begin(), bin_frequencies_.end(),
+                       static_cast<float>(options.max_frequency)) -
+      bin_frequencies_.begin();
+  std::fill(magnitudes + count, magnitudes + total, 0.0f);
+  MaxSum reduced = k.max_sum(magnitudes, count);
+  output.max_amplitude = reduced.max;
+  output.avg_amplitude = count > 0 ? reduced.sum / count : 0.0f;
+  k.scale(magnitudes, count, reduced.max > 0.0f ? 1.0f / reduced.max : 0.0f);
+
+  output.frequencies = bin_frequencies_;
+
+  if (options.keep_complex) {
+    output.re.resize(total);
+    output.im.resize(total);
+    size_t i = 0;
+    for (const Segment &segment : segments_) {
+      for (uint32_t bin = segment.first_bin; bin < segment.last_bin;
+           ++bin, ++i) {
+        const fftwf_complex &value = out[segment.level * out_size + bin];
+        output.re[i] = value[0];
+        output.im[i] = value[1];
+      }
+    }
+  } else {
+    output.re.clear();
+    output.im.clear();
+  }
+
+  output.band_amplitudes.resize(band_map_->size());
+  output.band_frequencies.resize(band_map_->size());
+  band_map_->Reduce(magnitudes, output.band_amplitudes.data(),
+                    output.band_frequencies.data());
+}
+
+} // namespace audio
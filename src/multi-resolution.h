@@ -0,0 +1,112 @@
+#pragma once
+#include "audio-processing.h"
+#include "band-map.h"
+#include "fft-plan-cache.h"
+#include "processed-audio.h"
+#include "stft.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace audio {
+
+// Streaming 2:1 decimator: a 63 tap windowed-sinc half-band lowpass, of
+// which every other tap is zero, evaluated for every second input sample.
+// Flat to 0.2 and at least ~70 dB down from 0.3 of the input rate.
+class HalfbandDecimator {
+public:
+  static constexpr size_t kCenter = 31;
+  static constexpr size_t kTaps = 2 * kCenter + 1;
+
+  // Writes one output per two inputs (count / 2, give or take one depending
+  // on the phase carried over from the previous call) and returns how many.
+  size_t Process(const float *in, size_t count, float *out);
+
+private:
+  // Every input is stored twice, kTaps apart, so the last kTaps inputs are
+  // always contiguous at delay_[pos_].
+  std::array<float, 2 * kTaps> delay_{};
+  size_t pos_ = 0;
+  bool odd_ = false;
+};
+
+// Octave-wise multi-resolution spectrum of an StftFrame, for bass resolution
+// a single FFT could only get with a window many times longer.
+//
+// Level 0 is an FFT of the frame at the capture rate. Every further level
+// halves the rate of the one above with a HalfbandDecimator and keeps its own
+// history of window_size decimated samples, so it runs an FFT of the same
+// size over a span twice as long with bins half as wide. Decimation is
+// incremental, only the frame's new_samples are filtered per hop.
+//
+// Level k contributes the bins from 0.4 to 0.8 of its Nyquist frequency
+// (level 0 up to Nyquist, the deepest level down to DC). They are merged in
+// ascending frequency into ProcessedAudioBuffer::magnitudes, which then holds
+// BinCount() unevenly spaced bins (their frequencies are a shared table per
+// configuration), and reduced to bands with a BandMap built for those
+// frequencies.
+class MultiResolutionAnalyzer {
+public:
+  static constexpr size_t kMaxLevels = 8;
+
+  // levels is clamped to [1, kMaxLevels], windows too short to split run a
+  // single level.
+  explicit MultiResolutionAnalyzer(size_t levels);
+
+  // Levels in use since the last frame.
+  size_t Levels() const { return levels_; }
+  // Number of merged bins for a window size and level count.
+  static size_t BinCount(size_t window_size, size_t levels);
+
+  // Same contract as computeFFTMultichannel. Frames must come from one
+  // continuous Stft; a change of window size, channel count or rate, or a
+  // frame flagged as a discontinuity, starts the decimated histories over.
+  void Process(const StftFrame &frame, size_t sample_rate,
+               ProcessedAudioFrame &output,
+               const FftOptions &options = FftOptions{});
+
+private:
+  // One decimated level of one row (channel, mid or side).
+  struct Level {
+    HalfbandDecimator decimator;
+    // Doubled like Stft's history, the window is at history[write_pos].
+    std::vector<float> history;
+    size_t write_pos = 0;
+  };
+  // Bins [first_bin, last_bin) of one level's FFT output.
+  struct Segment {
+    uint32_t level;
+    uint32_t first_bin;
+    uint32_t last_bin;
+  };
+
+  void Reconfigure(size_t window_size, size_t channels, size_t sample_rate);
+  // Clears the decimators and histories in place.
+  void Restart();
+  void FillBuffer(const fftwf_complex *out, ProcessedAudioBuffer &output,
+                  const FftOptions &options);
+
+  size_t requested_levels_;
+  size_t levels_ = 1;
+  size_t window_size_ = 0;
+  size_t channels_ = 0;
+  size_t sample_rate_ = 0;
+
+  // (channels + 2) * (levels_ - 1), row major.
+  std::vector<Level> decimated_;
+  std::vector<Segment> segments_;
+  std::span<const float> bin_frequencies_;
+  std::unique_ptr<BandMap> band_map_;
+  BandMapKey band_map_key_{};
+
+  FftwfBuffer<float> in_;
+  FftwfBuffer<fftwf_complex> out_;
+  std::vector<float> mid_, side_;
+  // New samples of the level being filled and of the one below it.
+  std::array<std::vector<float>, 2> fresh_;
+};
+
+} // namespace audio
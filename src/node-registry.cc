@@ -0,0 +1,114 @@
+#include "node-registry.h"
+#include "pipewire/pipewire.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace Visualizer {
+namespace {
+
+static void on_global(void *data, uint32_t id, uint32_t permissions,
+                      const char *type, uint32_t version,
+                      const struct spa_dict *props) {
+  static_cast<NodeRegistry *>(data)->OnGlobal(id, type, props);
+}
+
+static void on_global_remove(void *data, uint32_t id) {
+  static_cast<NodeRegistry *>(data)->OnGlobalRemove(id);
+}
+
+static const struct pw_registry_events registry_events = {
+    .version = PW_VERSION_REGISTRY_EVENTS,
+    .global = on_global,
+    .global_remove = on_global_remove,
+};
+
+std::optional<std::regex> compile(const std::string &pattern, bool &valid) {
+  if (pattern.empty())
+    return std::nullopt;
+  try {
+    return std::regex(pattern, std::regex::ECMAScript | std::regex::optimize);
+  } catch (const std::regex_error &e) {
+    fprintf(stderr, "invalid source pattern %s: %s\n", pattern.c_str(),
+            e.what());
+    valid = false;
+    return std::nullopt;
+  }
+}
+
+std::string lookup(const struct spa_dict *props, const char *key) {
+  const char *value = spa_dict_lookup(props, key);
+  return value != nullptr ? value : "";
+}
+
+} // namespace
+
+NodeSelector::NodeSelector(const std::string &name,
+                           const std::string &media_class)
+    : name_(compile(name, valid_)),
+      media_class_(compile(media_class, valid_)) {}
+
+bool NodeSelector::Matches(const AudioNode &node) const {
+  if (!valid_)
+    return false;
+  if (media_class_ && !std::regex_search(node.media_class, *media_class_))
+    return false;
+  return !name_ || std::regex_search(node.name, *name_) ||
+         std::regex_search(node.description, *name_) ||
+         std::regex_search(node.application, *name_);
+}
+
+NodeRegistry::NodeRegistry(PipewireSession &session) : session_(session) {
+  if (!session_.Connected())
+    return;
+  PipewireSession::Lock lock(session_);
+  registry_ = pw_core_get_registry(session_.Core(), PW_VERSION_REGISTRY, 0);
+  spa_zero(listener_);
+  pw_registry_add_listener(registry_, &listener_, &registry_events, this);
+}
+
+NodeRegistry::~NodeRegistry() {
+  if (registry_ == nullptr)
+    return;
+  PipewireSession::Lock lock(session_);
+  spa_hook_remove(&listener_);
+  pw_proxy_destroy(reinterpret_cast<struct pw_proxy *>(registry_));
+}
+
+std::vector<AudioNode> NodeRegistry::Nodes() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return nodes_;
+}
+
+void NodeRegistry::OnGlobal(uint32_t id, const char *type,
+                            const struct spa_dict *props) {
+  if (props == nullptr || std::strcmp(type, PW_TYPE_INTERFACE_Node) != 0)
+    return;
+  std::string media_class = lookup(props, PW_KEY_MEDIA_CLASS);
+  if (media_class.find("Audio") == std::string::npos)
+    return;
+
+  AudioNode node{.id = id,
+                 .serial = std::strtoull(
+                     lookup(props, PW_KEY_OBJECT_SERIAL).c_str(), nullptr, 10),
+                 .name = lookup(props, PW_KEY_NODE_NAME),
+                 .description = lookup(props, PW_KEY_NODE_DESCRIPTION),
+                 .application = lookup(props, PW_KEY_APP_NAME),
+                 .media_class = std::move(media_class)};
+  std::lock_guard<std::mutex> lock(mtx_);
+  nodes_.push_back(std::move(node));
+  generation_.fetch_add(1, std::memory_order_release);
+}
+
+void NodeRegistry::OnGlobalRemove(uint32_t id) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto it = std::find_if(nodes_.begin(), nodes_.end(),
+                         [id](const AudioNode &node) { return node.id == id; });
+  if (it == nodes_.end())
+    return;
+  nodes_.erase(it);
+  generation_.fetch_add(1, std::memory_order_release);
+}
+
+} // namespace Visualizer
@@ -0,0 +1,82 @@
+#pragma once
+#include "pipewire-session.h"
+#include "pipewire/core.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace Visualizer {
+
+// An audio node of the graph as announced by the registry.
+struct AudioNode {
+  uint32_t id;
+  // Unique for the lifetime of the PipeWire daemon, unlike ids and names.
+  uint64_t serial = 0;
+  std::string name;
+  std::string description;
+  std::string application;
+  std::string media_class;
+};
+
+// Which nodes to capture. Patterns are ECMAScript regexes searched for
+// anywhere in the property. The name pattern is tried against the node name,
+// description and application name; an empty pattern matches anything.
+class NodeSelector {
+public:
+  // Sources and applications playing audio, not other capture streams
+  // (including our own).
+  static constexpr const char *kDefaultMediaClass =
+      "^(Audio/Source|Stream/Output/Audio)$";
+
+  explicit NodeSelector(const std::string &name = "",
+                        const std::string &media_class = kDefaultMediaClass);
+
+  // False if a pattern did not compile, the selector then matches nothing.
+  bool Valid() const { return valid_; }
+  bool Matches(const AudioNode &node) const;
+
+private:
+  // Before the patterns, compiling them may clear it.
+  bool valid_ = true;
+  std::optional<std::regex> name_;
+  std::optional<std::regex> media_class_;
+};
+
+// Live list of the audio nodes of the session's graph. Registry events
+// arrive on the PipeWire loop thread, readers on any thread poll
+// Generation() and take a snapshot with Nodes() when it changed.
+class NodeRegistry {
+public:
+  explicit NodeRegistry(PipewireSession &session);
+  ~NodeRegistry();
+
+  NodeRegistry(const NodeRegistry &) = delete;
+  NodeRegistry &operator=(const NodeRegistry &) = delete;
+
+  // Bumped whenever a node appears or goes away.
+  uint64_t Generation() const {
+    return generation_.load(std::memory_order_acquire);
+  }
+  // In order of appearance.
+  std::vector<AudioNode> Nodes() const;
+
+  // Registry listener callbacks, PipeWire loop thread.
+  void OnGlobal(uint32_t id, const char *type, const struct spa_dict *props);
+  void OnGlobalRemove(uint32_t id);
+
+private:
+  PipewireSession &session_;
+  struct pw_registry *registry_ = nullptr;
+  struct spa_hook listener_;
+
+  mutable std::mutex mtx_;
+  // In order of appearance, ids are reused once a node went away.
+  std::vector<AudioNode> nodes_;
+  std::atomic<uint64_t> generation_{0};
+};
+
+} // namespace Visualizer
@@ -0,0 +1,274 @@
+#include "offline-render.h"
+#include "audio-processor.h"
+#include "frame-pacer.h"
+#include "raylib.h"
+#include "renderers.h"
+#include "rlgl.h"
+#include "simd-kernels.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <semaphore>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace audio {
+namespace {
+
+// Reads the input on demand and turns it into the spectrum to show at a given
+// point of the audio timeline. Everything is stamped on that timeline, so the
+// output does not depend on how fast frames are produced.
+class OfflineAnalysis {
+public:
+  OfflineAnalysis(std::unique_ptr<SampleReader> reader,
+                  const OfflineRenderOptions &options)
+      : reader_(std::move(reader)), format_(reader_->Format()),
+        stft_(options.stft, std::min(format_.channels, kMaxAnalysedChannels)),
+        processor_(options.input, format_.sample_rate, stft_.WindowSize(),
+                   options.fft),
+        interleaved_(stft_.HopSize() * format_.channels),
+        planar_(format_.channels, std::vector<float>(stft_.HopSize())) {
+    for (auto &row : planar_)
+      rows_.push_back(row.data());
+  }
+
+  // Fills frame with the spectrum around time_ns: mid is the blend of the
+  // analysis windows centred either side of it, beat is the newest one's.
+  // Returns false once the input ended before time_ns.
+  bool Advance(int64_t time_ns, ProcessedAudioFrame &frame) {
+    while (!ended_ && newest_ns_ < time_ns) {
+      const size_t read = reader_->Read(interleaved_.data(), stft_.HopSize());
+      if (read == 0) {
+        ended_ = true;
+        break;
+      }
+      deinterleave(interleaved_.data(), read, format_.channels, rows_.data());
+      stft_.Push(rows_.data(), read, [&](const StftFrame &stft_frame) {
+        processor_.OnNewSample(stft_frame);
+        const ProcessedAudioFrame &processed = processor_.Buffer();
+        // A window shows best at its centre.
+        newest_ns_ = SamplesToNs(stft_.SamplesPushed() -
+                                 stft_.WindowSize() / 2);
+        pacer_.Push(processed.mid, newest_ns_, newest_ns_);
+        beat_ = processed.beat;
+      });
+    }
+    if (newest_ns_ < time_ns)
+      return false;
+    // The pacer shows one frame interval behind the time it is given.
+    frame.mid = pacer_.Spectrum(time_ns + pacer_.FrameIntervalNs());
+    frame.beat = beat_;
+    return true;
+  }
+
+private:
+  int64_t SamplesToNs(uint64_t samples) const {
+    return int64_t(samples * 1000000000 / format_.sample_rate);
+  }
+
+  std::unique_ptr<SampleReader> reader_;
+  StreamFormat format_;
+  Stft stft_;
+  AudioProcessor processor_;
+  FramePacer pacer_;
+  std::vector<float> interleaved_;
+  std::vector<std::vector<float>> planar_;
+  std::vector<float *> rows_;
+  int64_t newest_ns_ = -1;
+  BeatInfo beat_;
+  bool ended_ = false;
+};
+
+// True if pattern holds exactly one %d conversion, optionally with a 0 flag
+// and a width, and otherwise only literal %% escapes, so it is safe to hand to
+// snprintf with the frame number.
+bool isFramePattern(const std::string &pattern) {
+  int conversions = 0;
+  for (size_t i = 0; i < pattern.size(); ++i) {
+    if (pattern[i] != '%')
+      continue;
+    if (++i < pattern.size() && pattern[i] == '%')
+      continue;
+    while (i < pattern.size() && pattern[i] >= '0' && pattern[i] <= '9')
+      ++i;
+    if (i == pattern.size() || pattern[i] != 'd')
+      return false;
+    ++conversions;
+  }
+  return conversions == 1;
+}
+
+class FrameWriter {
+public:
+  explicit FrameWriter(const OfflineRenderOptions &options)
+      : options_(options) {}
+  ~FrameWriter() {
+    if (file_ != nullptr && file_ != stdout)
+      fclose(file_);
+  }
+
+  bool Open() {
+    if (options_.format == FrameFormat::kPng) {
+      if (isFramePattern(options_.output))
+        return true;
+      fprintf(stderr,
+              "render: %s is not a frame pattern, it wants a single %%d "
+              "like frames/%%06d.png\n",
+              options_.output.c_str());
+      return false;
+    }
+    file_ = options_.output == "-" ? stdout
+                                   : fopen(options_.output.c_str(), "wb");
+    if (file_ == nullptr) {
+      fprintf(stderr, "render: cannot open %s\n", options_.output.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  bool Write(std::vector<uint8_t> &rgba, uint64_t frame_number) {
+    if (options_.format == FrameFormat::kRawRgba)
+      return fwrite(rgba.data(), 1, rgba.size(), file_) == rgba.size();
+    char path[4096];
+    snprintf(path, sizeof(path), options_.output.c_str(),
+             static_cast<int>(frame_number));
+    Image image{.data = rgba.data(),
+                .width = options_.width,
+                .height = options_.height,
+                .mipmaps = 1,
+                .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+    return ExportImage(image, path);
+  }
+
+private:
+  const OfflineRenderOptions &options_;
+  FILE *file_ = nullptr;
+};
+
+// Copies the render texture to rgba, top row first. GL textures are stored
+// bottom row first.
+void ReadBack(const RenderTexture2D &target, std::vector<uint8_t> &rgba) {
+  const Texture2D &texture = target.texture;
+  auto *pixels = static_cast<uint8_t *>(rlReadTexturePixels(
+      texture.id, texture.width, texture.height, texture.format));
+  const size_t stride = size_t(texture.width) * 4;
+  for (int y = 0; y < texture.height; ++y)
+    std::memcpy(rgba.data() + y * stride,
+                pixels + (texture.height - 1 - y) * stride, stride);
+  MemFree(pixels);
+}
+
+} // namespace
+
+int runOfflineRender(const OfflineRenderOptions &options) {
+  if (options.fps <= 0 || options.width <= 0 || options.height <= 0) {
+    fprintf(stderr, "render: invalid frame rate or size\n");
+    return 1;
+  }
+  auto reader =
+      openSampleReader(options.input, options.raw_format, options.seconds);
+  if (!reader) {
+    fprintf(stderr, "render: cannot open input %s\n", options.input.c_str());
+    return 1;
+  }
+  FrameWriter writer(options);
+  if (!writer.Open())
+    return 1;
+
+  // raylib logs to stdout, which may be carrying the frames.
+  SetTraceLogLevel(options.output == "-" ? LOG_NONE : LOG_WARNING);
+  SetConfigFlags(FLAG_WINDOW_HIDDEN);
+  InitWindow(options.width, options.height, "render");
+  if (!IsWindowReady()) {
+    fprintf(stderr, "render: no GL context\n");
+    return 1;
+  }
+  RenderTexture2D target = LoadRenderTexture(options.width, options.height);
+  SetAnimationTimeStep(1.0f / options.fps);
+
+  BarOptions bar_options;
+  CircleOptions circle_options;
+  WaveOptions wave_options;
+  SpectrogramOptions spectrogram_options;
+
+  OfflineAnalysis analysis(std::move(reader), options);
+  // The render thread shows slots[n % 2] while the worker fills the other.
+  ProcessedAudioFrame slots[2] = {ProcessedAudioFrame(0),
+                                  ProcessedAudioFrame(0)};
+  bool slot_valid[2] = {};
+  auto frame_time_ns = [&](uint64_t n) {
+    return int64_t(n * 1000000000 / options.fps);
+  };
+
+  std::binary_semaphore start(0), done(0);
+  uint64_t next_frame = 0;
+  std::atomic<bool> stop = false;
+  std::thread worker([&] {
+    while (true) {
+      start.acquire();
+      if (stop)
+        return;
+      const size_t slot = next_frame % 2;
+      slot_valid[slot] =
+          analysis.Advance(frame_time_ns(next_frame), slots[slot]);
+      done.release();
+    }
+  });
+
+  std::vector<uint8_t> rgba(size_t(options.width) * options.height * 4);
+  bool ok = true;
+  const auto wall_start = std::chrono::steady_clock::now();
+  slot_valid[0] = analysis.Advance(0, slots[0]);
+  uint64_t n = 0;
+  for (; slot_valid[n % 2]; ++n) {
+    ProcessedAudioFrame &frame = slots[n % 2];
+    // Lets the spectrogram take exactly one row per video frame.
+    frame.timing.publish_ns = frame_time_ns(n) + 1;
+
+    next_frame = n + 1;
+    start.release();
+
+    BeginTextureMode(target);
+    ClearBackground(BLACK);
+    RenderSpectrogram(frame, spectrogram_options);
+    RenderBars(frame.mid, bar_options);
+    RenderCircle(frame.mid, frame.beat, circle_options);
+    RenderWave(frame.mid, wave_options);
+    EndTextureMode();
+    ReadBack(target, rgba);
+    ok = writer.Write(rgba, n);
+
+    done.acquire();
+    if (!ok) {
+      fprintf(stderr, "render: writing frame %lu failed\n", n);
+      break;
+    }
+  }
+  stop = true;
+  start.release();
+  worker.join();
+
+  const double wall = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - wall_start)
+                          .count();
+  const double video_seconds = double(n) / options.fps;
+  fprintf(stderr,
+          "render: %lu frames %dx%d @ %d fps (%.1f s) in %.2f s, %.1fx real "
+          "time\n",
+          n, options.width, options.height, options.fps, video_seconds, wall,
+          wall > 0 ? video_seconds / wall : 0.0);
+
+  SetAnimationTimeStep(0.0f);
+  UnloadBarRenderer();
+  UnloadSpectrogramRenderer();
+  UnloadRenderTexture(target);
+  CloseWindow();
+  return ok ? 0 : 1;
+}
+
+} // namespace audio
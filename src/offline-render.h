@@ -0,0 +1,41 @@
+#pragma once
+#include "audio-processing.h"
+#include "input-source.h"
+#include "stft.h"
+#include <string>
+
+namespace audio {
+
+enum class FrameFormat {
+  // Unframed width * height * 4 bytes per frame, top row first.
+  kRawRgba,
+  // One file per frame.
+  kPng,
+};
+
+struct OfflineRenderOptions {
+  // Synthetic signal spec or file path, see openSampleReader.
+  std::string input;
+  StreamFormat raw_format;
+  float seconds = 10.0f;
+  StftOptions stft;
+  FftOptions fft;
+  // Raw frames are written to this file, "-" for stdout. For PNG frames it is
+  // a pattern with a single %d (0 flag and width allowed) taking the frame
+  // number, e.g. "frames/%06d.png".
+  std::string output;
+  FrameFormat format = FrameFormat::kRawRgba;
+  int fps = 60;
+  int width = 1000;
+  int height = 1000;
+};
+
+// Renders the input to video frames as fast as it goes, with no dependence on
+// the wall clock: every frame advances the audio and the animations by
+// exactly 1 / fps, is drawn into an off-screen render texture in a hidden
+// window and read back. The next frame's analysis runs on a second thread
+// while the current one is read back and written. Returns the process exit
+// code.
+int runOfflineRender(const OfflineRenderOptions &options);
+
+} // namespace audio
@@ -0,0 +1,57 @@
+#include "paced-source.h"
+#include "clock.h"
+#include <chrono>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+namespace audio {
+
+PacedSource::PacedSource(std::string name,
+                         std::unique_ptr<SampleReader> reader,
+                         StftOptions stft, FrameCallback callback,
+                         AnalysisWorkerOptions worker_options)
+    : name_(std::move(name)), reader_(std::move(reader)),
+      format_(reader_->Format()), callback_(std::move(callback)),
+      worker_(name_ + "_fft", stft, stft.window_size * 4 * format_.channels,
+              [this](const StftFrame &frame) {
+                callback_(frame, format_.sample_rate);
+              },
+              worker_options) {
+  worker_.SetSampleRate(format_.sample_rate);
+}
+
+void PacedSource::Start() {
+  if (running_.exchange(true))
+    return;
+  worker_.Start();
+  thread_ = std::thread(&PacedSource::Run, this);
+}
+
+void PacedSource::Stop() {
+  if (!running_.exchange(false))
+    return;
+  thread_.join();
+  worker_.Stop();
+}
+
+void PacedSource::Run() {
+  using clock = std::chrono::steady_clock;
+  std::vector<float> quantum(kQuantum * format_.channels);
+  const auto period = std::chrono::duration_cast<clock::duration>(
+      std::chrono::duration<double>(double(kQuantum) / format_.sample_rate));
+  auto next = clock::now();
+
+  while (running_.load(std::memory_order_relaxed)) {
+    size_t frames = reader_->Read(quantum.data(), kQuantum);
+    if (frames == 0) {
+      fprintf(stdout, "%s: end of input\n", name_.c_str());
+      return;
+    }
+    worker_.Push(quantum.data(), frames, format_.channels, monotonicNs());
+    next += period;
+    std::this_thread::sleep_until(next);
+  }
+}
+
+} // namespace audio
@@ -0,0 +1,41 @@
+#pragma once
+#include "analysis-worker.h"
+#include "input-source.h"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace audio {
+
+// Plays a SampleReader at real-time pace into an analysis pipeline, so files
+// and synthetic signals can stand in for a PipeWire capture.
+class PacedSource : public InputSource {
+public:
+  PacedSource(std::string name, std::unique_ptr<SampleReader> reader,
+              StftOptions stft, FrameCallback callback,
+              AnalysisWorkerOptions worker_options = AnalysisWorkerOptions{});
+  ~PacedSource() override { Stop(); }
+
+  const std::string &Name() const override { return name_; }
+  void Start() override;
+  void Stop() override;
+
+  StreamFormat Format() const { return format_; }
+
+private:
+  // Frames handed over per wakeup, mimics a PipeWire quantum.
+  static constexpr size_t kQuantum = 512;
+
+  void Run();
+
+  std::string name_;
+  std::unique_ptr<SampleReader> reader_;
+  StreamFormat format_;
+  FrameCallback callback_;
+  AnalysisWorker worker_;
+  std::thread thread_;
+  std::atomic<bool> running_{false};
+};
+
+} // namespace audio
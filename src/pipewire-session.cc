@@ -0,0 +1,34 @@
+#include "pipewire-session.h"
+#include "pipewire/pipewire.h"
+#include <cstdio>
+#include <utility>
+
+namespace Visualizer {
+
+PipewireSession::PipewireSession(std::string name) : name_(std::move(name)) {
+  pw_init(nullptr, nullptr);
+
+  loop_ = pw_thread_loop_new(name_.c_str(), NULL);
+  // Every stream shares this context, hence its real-time data loop.
+  context_ = pw_context_new(
+      pw_thread_loop_get_loop(loop_),
+      pw_properties_new(PW_KEY_CONFIG_NAME, "client-rt.conf", NULL), 0);
+  pw_thread_loop_start(loop_);
+
+  Lock lock(*this);
+  core_ = pw_context_connect(context_, NULL, 0);
+  if (core_ == nullptr)
+    fprintf(stderr, "%s: cannot connect to pipewire\n", name_.c_str());
+}
+
+PipewireSession::~PipewireSession() {
+  // Streams are gone by now, tear down in reverse order of creation.
+  pw_thread_loop_stop(loop_);
+  if (core_)
+    pw_core_disconnect(core_);
+  pw_context_destroy(context_);
+  pw_thread_loop_destroy(loop_);
+  pw_deinit();
+}
+
+} // namespace Visualizer
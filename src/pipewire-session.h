@@ -0,0 +1,46 @@
+#pragma once
+#include "pipewire/context.h"
+#include "pipewire/core.h"
+#include "pipewire/thread-loop.h"
+#include <string>
+
+namespace Visualizer {
+
+// One PipeWire connection for the whole process: a single thread loop,
+// context and core that any number of AudioStreams attach to and detach from.
+// Must outlive every stream created on it.
+class PipewireSession {
+public:
+  explicit PipewireSession(std::string name = "audio-visualizer");
+  ~PipewireSession();
+
+  PipewireSession(const PipewireSession &) = delete;
+  PipewireSession &operator=(const PipewireSession &) = delete;
+
+  bool Connected() const { return core_ != nullptr; }
+  struct pw_core *Core() const { return core_; }
+  struct pw_thread_loop *Loop() const { return loop_; }
+
+  // Holds the thread loop lock, required around every call that touches
+  // objects living on the loop (streams, proxies, listeners).
+  class Lock {
+  public:
+    explicit Lock(const PipewireSession &session) : loop_(session.loop_) {
+      pw_thread_loop_lock(loop_);
+    }
+    ~Lock() { pw_thread_loop_unlock(loop_); }
+    Lock(const Lock &) = delete;
+    Lock &operator=(const Lock &) = delete;
+
+  private:
+    struct pw_thread_loop *loop_;
+  };
+
+private:
+  std::string name_;
+  struct pw_thread_loop *loop_ = nullptr;
+  struct pw_context *context_ = nullptr;
+  struct pw_core *core_ = nullptr;
+};
+
+} // namespace Visualizer
@@ -1,44 +1,138 @@
 #pragma once
-#include <cmath>
+#include "band-map.h"
 #include <cstddef>
+#include <cstdint>
+#include <new>
+#include <span>
 #include <vector>
 
 namespace audio {
-constexpr auto squashed_sample_size = [](size_t raw_samples_count) {
-  size_t count = 0;
-  float step = 1.06;
-  float lowf = 1.0f;
-  for (float f = lowf; (size_t)f < raw_samples_count / 2;
-       f = std::ceilf(f * step)) {
-    count++;
-  }
-  return count;
-};
+// Cache line aligned storage, so the per-bin loops start on a vector
+// boundary.
+template <typename T, size_t alignment = 64> struct AlignedAllocator {
+  using value_type = T;
+  template <typename U> struct rebind {
+    using other = AlignedAllocator<U, alignment>;
+  };
 
-struct ProcessedAudioSample {
-  float sine_component;
-  float cosine_component;
-  float normalized_amplitude;
-  float frequency;
-};
+  AlignedAllocator() = default;
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, alignment> &) {}
 
-struct FreqAmpPair {
-  float normalized_amplitude;
-  float frequency;
+  T *allocate(size_t count) {
+    return static_cast<T *>(
+        ::operator new(count * sizeof(T), std::align_val_t(alignment)));
+  }
+  void deallocate(T *data, size_t) {
+    ::operator delete(data, std::align_val_t(alignment));
+  }
+  bool operator==(const AlignedAllocator &) const = default;
 };
 
+template <typename T> using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// One spectrum, one contiguous array per quantity.
 class ProcessedAudioBuffer {
 public:
   explicit ProcessedAudioBuffer(size_t buffer_size)
-      : samples(buffer_size),
-        squashed_samples(squashed_sample_size(buffer_size)) {}
+      : magnitudes(buffer_size),
+        band_amplitudes(geometric::bandCount(buffer_size)),
+        band_frequencies(geometric::bandCount(buffer_size)) {}
 
-  std::vector<ProcessedAudioSample> samples;
-  std::vector<FreqAmpPair> squashed_samples;
-  float max_amplitude;
-  float avg_amplitude;
+  // Per bin magnitude, normalised to the frame's loudest bin.
+  AlignedVector<float> magnitudes;
+  // Per bin real and imaginary parts, only filled with
+  // FftOptions::keep_complex, empty otherwise.
+  AlignedVector<float> re;
+  AlignedVector<float> im;
+  // Per bin centre frequency, a table shared by every buffer of the same
+  // configuration (see frequency-table.h). Empty until the first analysis.
+  std::span<const float> frequencies;
+  // The bins reduced to display bands, see BandMap.
+  AlignedVector<float> band_amplitudes;
+  AlignedVector<float> band_frequencies;
+  float max_amplitude = 0.0f;
+  float avg_amplitude = 0.0f;
 };
 
-// template <size_t sample_count> struct ProcessedAudioBuffer {};
+// Read-only view of a spectrum, what its consumers (renderers, beat tracking,
+// shared memory readers) take. Valid while the viewed buffer is.
+struct ProcessedAudioView {
+  ProcessedAudioView() = default;
+  ProcessedAudioView(const ProcessedAudioBuffer &buffer)
+      : magnitudes(buffer.magnitudes), re(buffer.re), im(buffer.im),
+        frequencies(buffer.frequencies),
+        band_amplitudes(buffer.band_amplitudes),
+        band_frequencies(buffer.band_frequencies),
+        max_amplitude(buffer.max_amplitude),
+        avg_amplitude(buffer.avg_amplitude) {}
+
+  std::span<const float> magnitudes;
+  std::span<const float> re;
+  std::span<const float> im;
+  std::span<const float> frequencies;
+  std::span<const float> band_amplitudes;
+  std::span<const float> band_frequencies;
+  float max_amplitude = 0.0f;
+  float avg_amplitude = 0.0f;
+};
+
+// Channels beyond this are captured but not analysed.
+constexpr size_t kMaxAnalysedChannels = 8;
+
+// CLOCK_MONOTONIC timestamps of the stages a frame went through, 0 when
+// unknown.
+struct FrameTiming {
+  int64_t capture_ns = 0;
+  int64_t fft_start_ns = 0;
+  int64_t fft_end_ns = 0;
+  int64_t publish_ns = 0;
+};
+
+// Onsets and tempo of the mid signal up to this frame, see BeatTracker.
+// Events are running counts, so a reader skipping frames misses none.
+struct BeatInfo {
+  float flux = 0.0f;
+  float threshold = 0.0f;
+  uint64_t onsets = 0;
+  uint64_t beats = 0;
+  // 0 until a tempo has been found.
+  float bpm = 0.0f;
+  // Position within the current beat, [0, 1).
+  float beat_phase = 0.0f;
+};
+
+// Time-domain levels of all channels up to this frame, see LoudnessMeter.
+// Levels in dB, LoudnessMeter::kFloorDb for silence.
+struct LevelInfo {
+  // Unweighted, over the last 400 ms.
+  float rms_dbfs = -120.0f;
+  // 4x oversampled peak of the samples new in this frame, and since start.
+  float true_peak_dbtp = -120.0f;
+  float max_true_peak_dbtp = -120.0f;
+  // K-weighted loudness over 400 ms, 3 s and the whole input (gated).
+  float momentary_lufs = -120.0f;
+  float short_term_lufs = -120.0f;
+  float integrated_lufs = -120.0f;
+};
+
+// Every spectrum computed from one analysis window: one per captured channel
+// plus the mid (mean of all channels) and side ((ch0 - ch1) / 2) signals. For
+// mono sources mid equals channel 0 and side is silent.
+class ProcessedAudioFrame {
+public:
+  explicit ProcessedAudioFrame(size_t buffer_size)
+      : channels(kMaxAnalysedChannels, ProcessedAudioBuffer(buffer_size)),
+        mid(buffer_size), side(buffer_size) {}
+
+  // Only the first channel_count entries are valid.
+  std::vector<ProcessedAudioBuffer> channels;
+  size_t channel_count = 0;
+  ProcessedAudioBuffer mid;
+  ProcessedAudioBuffer side;
+  BeatInfo beat;
+  LevelInfo levels;
+  FrameTiming timing;
+};
 
 } // namespace audio
@@ -0,0 +1,506 @@
+#include "renderers.h"
+#include "rlgl.h"
+#include "wave-synth.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#ifndef AUDIO_VISUALIZER_SHADER_DIR
+#define AUDIO_VISUALIZER_SHADER_DIR "."
+#endif
+
+// Reference rate for the wave's horizontal frequency scale.
+static constexpr size_t sample_rate = 48000;
+
+// Seconds per frame when fixed, see SetAnimationTimeStep.
+static float fixed_time_step = 0.0f;
+
+static float FrameTime() {
+  return fixed_time_step > 0.0f ? fixed_time_step : GetFrameTime();
+}
+
+void SetAnimationTimeStep(float seconds) { fixed_time_step = seconds; }
+
+// Fraction of the remaining distance an animated value covers this frame.
+// Exponential in the frame time, so the motion is the same at any frame rate
+// and never overshoots on long frames.
+static float SmoothingStep(float smoothness) {
+  return 1.0f - std::exp(-FrameTime() * smoothness);
+}
+
+// Smooths the bar heights towards the current spectrum, in pixels. Returns
+// whether they have settled, no bar more than a hundredth of a pixel away
+// from its target.
+static bool UpdateBarHeights(audio::ProcessedAudioView audio_buffer,
+                             const BarOptions &bar_options,
+                             std::vector<float> &rendered_bar_heights) {
+  size_t bar_count = audio_buffer.band_amplitudes.size();
+  // The band count depends on the band scale and the negotiated rate.
+  rendered_bar_heights.resize(bar_count);
+
+  const float step = SmoothingStep(bar_options.anim_smoothness);
+  bool settled = true;
+  for (int i = 0; i < bar_count; i++) {
+    float bar_height = bar_options.min_height;
+    if (audio_buffer.max_amplitude > 5.0f)
+      bar_height =
+          std::max(audio_buffer.band_amplitudes[i] * bar_options.height_mult,
+                   bar_height);
+
+    float distance = bar_height - rendered_bar_heights[i];
+    rendered_bar_heights[i] += distance * step;
+    settled = settled && std::abs(distance) < 0.01f;
+  }
+  return settled;
+}
+
+namespace {
+// The shader and height texture of the batched bar renderer. Created on first
+// use, once the GL context exists.
+struct BarBatch {
+  Shader shader{};
+  Texture2D heights{};
+  int bar_count_loc, bar_width_loc, size_loc, pos_y_offset_loc, hue_start_loc,
+      hue_range_loc, hue_speed_loc, time_loc, gradient_loc;
+  bool loaded = false;
+  // The heights texture holds the current bar heights.
+  bool uploaded = false;
+
+  bool Ready() const {
+    return shader.id != 0 && shader.id != rlGetShaderIdDefault();
+  }
+
+  void Load() {
+    loaded = true;
+    shader = LoadShader(AUDIO_VISUALIZER_SHADER_DIR "/vertex.vs",
+                        AUDIO_VISUALIZER_SHADER_DIR "/fragment.fs");
+    if (!Ready()) {
+      fprintf(stderr, "bars: shader unavailable, drawing on the CPU\n");
+      return;
+    }
+    bar_count_loc = GetShaderLocation(shader, "barCount");
+    bar_width_loc = GetShaderLocation(shader, "barWidth");
+    size_loc = GetShaderLocation(shader, "size");
+    pos_y_offset_loc = GetShaderLocation(shader, "posYOffset");
+    hue_start_loc = GetShaderLocation(shader, "hueStart");
+    hue_range_loc = GetShaderLocation(shader, "hueRange");
+    hue_speed_loc = GetShaderLocation(shader, "hueSpeed");
+    time_loc = GetShaderLocation(shader, "time");
+    gradient_loc = GetShaderLocation(shader, "gradient");
+  }
+
+  // One float texel per bar, recreated when the band count changes.
+  void Upload(const std::vector<float> &bar_heights) {
+    uploaded = true;
+    int bar_count = static_cast<int>(bar_heights.size());
+    if (heights.id == 0 || heights.width != bar_count) {
+      if (heights.id != 0)
+        UnloadTexture(heights);
+      heights = LoadTextureFromImage(
+          {.data = const_cast<float *>(bar_heights.data()),
+           .width = bar_count,
+           .height = 1,
+           .mipmaps = 1,
+           .format = PIXELFORMAT_UNCOMPRESSED_R32});
+      SetTextureFilter(heights, TEXTURE_FILTER_POINT);
+      return;
+    }
+    UpdateTexture(heights, bar_heights.data());
+  }
+
+  void Unload() {
+    if (heights.id != 0)
+      UnloadTexture(heights);
+    if (Ready())
+      UnloadShader(shader);
+    *this = BarBatch{};
+  }
+};
+
+BarBatch bar_batch;
+} // namespace
+
+static void SetUniform(int loc, float value) {
+  SetShaderValue(bar_batch.shader, loc, &value, SHADER_UNIFORM_FLOAT);
+}
+
+// Draws every bar with a single textured quad, hue and gradient are worked
+// out per fragment.
+static void RenderBarsBatched(const std::vector<float> &bar_heights,
+                              const BarOptions &bar_options, float start_x,
+                              float bar_width, float time) {
+  if (!bar_batch.uploaded)
+    bar_batch.Upload(bar_heights);
+  float bar_count = bar_heights.size();
+  Vector2 size = {.x = 2.0f * bar_width * bar_count,
+                  .y = static_cast<float>(GetRenderHeight())};
+
+  BeginShaderMode(bar_batch.shader);
+  SetUniform(bar_batch.bar_count_loc, bar_count);
+  SetUniform(bar_batch.bar_width_loc, bar_width);
+  SetShaderValue(bar_batch.shader, bar_batch.size_loc, &size,
+                 SHADER_UNIFORM_VEC2);
+  SetUniform(bar_batch.pos_y_offset_loc, bar_options.pos_y_offset);
+  SetUniform(bar_batch.hue_start_loc, bar_options.hue_start);
+  SetUniform(bar_batch.hue_range_loc, bar_options.hue_dynamic_range);
+  SetUniform(bar_batch.hue_speed_loc, bar_options.enable_changing_hue
+                                          ? bar_options.changing_hue_speed
+                                          : 0.0f);
+  SetUniform(bar_batch.time_loc, time);
+  SetUniform(bar_batch.gradient_loc, bar_options.gradient);
+  DrawTexturePro(bar_batch.heights,
+                 {.x = 0, .y = 0, .width = bar_count, .height = 1},
+                 {.x = start_x, .y = 0, .width = size.x, .height = size.y},
+                 {0, 0}, 0.0f, WHITE);
+  EndShaderMode();
+}
+
+void RenderBars(audio::ProcessedAudioView audio_buffer,
+                BarOptions bar_options, bool spectrum_changed) {
+  if (bar_options.disabled)
+    return;
+  static float time;
+  time += FrameTime();
+  float start_x = (GetRenderWidth() - drawable_width) / 2.0f;
+  size_t bar_count = audio_buffer.band_amplitudes.size();
+  float bar_width =
+      drawable_width / (2.0f * bar_count - 1) + bar_options.inbetween_gap;
+  static std::vector<float> rendered_bar_heights;
+  // Settled on an unchanged spectrum, the heights (and the texture holding
+  // them) stay as they are.
+  static bool settled = false;
+  static float settled_height_mult = 0.0f;
+  static float settled_min_height = 0.0f;
+  if (spectrum_changed || !settled ||
+      bar_options.height_mult != settled_height_mult ||
+      bar_options.min_height != settled_min_height) {
+    settled = UpdateBarHeights(audio_buffer, bar_options, rendered_bar_heights);
+    settled_height_mult = bar_options.height_mult;
+    settled_min_height = bar_options.min_height;
+    bar_batch.uploaded = false;
+  }
+
+  if (bar_options.gpu) {
+    if (!bar_batch.loaded)
+      bar_batch.Load();
+    if (bar_batch.Ready()) {
+      RenderBarsBatched(rendered_bar_heights, bar_options, start_x, bar_width,
+                        time);
+      return;
+    }
+  }
+
+  for (int i = 0; i < bar_count; i++) {
+    float bar_height = rendered_bar_heights[i];
+
+    float hue = bar_options.hue_start +
+                float(i) / bar_count * bar_options.hue_dynamic_range;
+
+    if (bar_options.enable_changing_hue)
+      hue += time * bar_options.changing_hue_speed;
+    float saturation = 1.0f;
+    float value = 1.0f;
+
+    Color color = ColorFromHSV(hue, saturation, value);
+
+    DrawRectangleRec(
+        {.x = start_x + 2 * i * bar_width,
+         .y = static_cast<float>((GetRenderHeight() - bar_height) / 2) -
+              bar_options.pos_y_offset,
+         .width = static_cast<float>(bar_width),
+         .height = static_cast<float>(bar_height)},
+        color);
+  }
+}
+
+void UnloadBarRenderer() { bar_batch.Unload(); }
+
+namespace {
+// Colour map stops, black through purple and orange to pale yellow.
+constexpr Color lut_stops[] = {{0, 0, 4, 255},       {40, 11, 84, 255},
+                               {101, 21, 110, 255},  {159, 42, 99, 255},
+                               {212, 72, 66, 255},   {245, 125, 21, 255},
+                               {250, 193, 39, 255},  {252, 255, 164, 255}};
+
+// Ring of spectrum rows on the GPU plus the shader scrolling through it.
+struct SpectrogramView {
+  Shader shader{};
+  Texture2D history{};
+  Texture2D lut{};
+  int lut_loc, offset_loc, db_range_loc;
+  bool loaded = false;
+  // Row the next frame goes to.
+  int next_row = 0;
+  int64_t last_publish_ns = 0;
+  std::vector<float> row;
+
+  bool Ready() const {
+    return shader.id != 0 && shader.id != rlGetShaderIdDefault();
+  }
+
+  void Load() {
+    loaded = true;
+    shader = LoadShader(AUDIO_VISUALIZER_SHADER_DIR "/vertex.vs",
+                        AUDIO_VISUALIZER_SHADER_DIR "/spectrogram.fs");
+    if (!Ready()) {
+      fprintf(stderr, "spectrogram: shader unavailable, view disabled\n");
+      return;
+    }
+    lut_loc = GetShaderLocation(shader, "lut");
+    offset_loc = GetShaderLocation(shader, "offset");
+    db_range_loc = GetShaderLocation(shader, "dbRange");
+
+    constexpr int lut_size = 256;
+    constexpr int segments = std::size(lut_stops) - 1;
+    std::array<Color, lut_size> colors;
+    for (int i = 0; i < lut_size; i++) {
+      float t = float(i) / (lut_size - 1) * segments;
+      int s = std::min(static_cast<int>(t), segments - 1);
+      float f = t - s;
+      const Color &a = lut_stops[s], &b = lut_stops[s + 1];
+      auto mix = [f](unsigned char x, unsigned char y) {
+        return static_cast<unsigned char>(x + (y - x) * f + 0.5f);
+      };
+      colors[i] = {mix(a.r, b.r), mix(a.g, b.g), mix(a.b, b.b), 255};
+    }
+    lut = LoadTextureFromImage({.data = colors.data(),
+                                .width = lut_size,
+                                .height = 1,
+                                .mipmaps = 1,
+                                .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8});
+    SetTextureFilter(lut, TEXTURE_FILTER_BILINEAR);
+  }
+
+  // (Re)creates a cleared ring when the row width or length changes.
+  void Resize(int width, int rows) {
+    if (history.id != 0 && history.width == width && history.height == rows)
+      return;
+    if (history.id != 0)
+      UnloadTexture(history);
+    std::vector<float> cleared(size_t(width) * rows, 0.0f);
+    history = LoadTextureFromImage({.data = cleared.data(),
+                                    .width = width,
+                                    .height = rows,
+                                    .mipmaps = 1,
+                                    .format = PIXELFORMAT_UNCOMPRESSED_R32});
+    // Point sampling keeps the oldest and newest rows from blending at the
+    // ring's seam.
+    SetTextureFilter(history, TEXTURE_FILTER_POINT);
+    next_row = 0;
+    row.resize(width);
+  }
+
+  // Only the new row crosses the bus, whatever the history length.
+  void Append() {
+    UpdateTextureRec(history,
+                     {.x = 0,
+                      .y = static_cast<float>(next_row),
+                      .width = static_cast<float>(history.width),
+                      .height = 1},
+                     row.data());
+    next_row = (next_row + 1) % history.height;
+  }
+
+  void Unload() {
+    if (history.id != 0)
+      UnloadTexture(history);
+    if (lut.id != 0)
+      UnloadTexture(lut);
+    if (Ready())
+      UnloadShader(shader);
+    *this = SpectrogramView{};
+  }
+};
+
+SpectrogramView spectrogram_view;
+} // namespace
+
+void RenderSpectrogram(const audio::ProcessedAudioFrame &frame,
+                       SpectrogramOptions spectrogram_options) {
+  if (spectrogram_options.disabled)
+    return;
+  if (!spectrogram_view.loaded)
+    spectrogram_view.Load();
+  if (!spectrogram_view.Ready())
+    return;
+
+  SpectrogramView &view = spectrogram_view;
+  const audio::ProcessedAudioBuffer &buffer = frame.mid;
+  int width = spectrogram_options.raw_bins
+                  ? std::min<int>(spectrogram_options.max_bin + 1,
+                                  buffer.magnitudes.size())
+                  : static_cast<int>(buffer.band_amplitudes.size());
+  if (width <= 0)
+    return;
+  view.Resize(width, std::max(spectrogram_options.history, 2));
+
+  // The render loop runs faster than the analysis, only frames not seen yet
+  // become a row.
+  if (frame.timing.publish_ns != 0 &&
+      frame.timing.publish_ns != view.last_publish_ns) {
+    view.last_publish_ns = frame.timing.publish_ns;
+    const float *levels = spectrogram_options.raw_bins
+                              ? buffer.magnitudes.data()
+                              : buffer.band_amplitudes.data();
+    std::copy(levels, levels + width, view.row.begin());
+    view.Append();
+  }
+
+  float offset = float(view.next_row) / view.history.height;
+  float height = spectrogram_options.height;
+  BeginShaderMode(view.shader);
+  SetShaderValueTexture(view.shader, view.lut_loc, view.lut);
+  SetShaderValue(view.shader, view.offset_loc, &offset, SHADER_UNIFORM_FLOAT);
+  SetShaderValue(view.shader, view.db_range_loc,
+                 &spectrogram_options.db_range, SHADER_UNIFORM_FLOAT);
+  DrawTexturePro(view.history,
+                 {.x = 0,
+                  .y = 0,
+                  .width = static_cast<float>(view.history.width),
+                  .height = static_cast<float>(view.history.height)},
+                 {.x = 0,
+                  .y = GetRenderHeight() - height,
+                  .width = static_cast<float>(GetRenderWidth()),
+                  .height = height},
+                 {0, 0}, 0.0f, WHITE);
+  EndShaderMode();
+}
+
+void UnloadSpectrogramRenderer() { spectrogram_view.Unload(); }
+
+void RenderCircle(audio::ProcessedAudioView audio_buffer,
+                  const audio::BeatInfo &beat, CircleOptions circle_options) {
+  if (circle_options.disabled)
+    return;
+  static float time;
+  time += FrameTime();
+  Vector2 center = {.x = GetRenderWidth() / 2.0f,
+                    .y = GetRenderHeight() / 2.0f};
+  float radius = (drawable_width * circle_options.radius_multiplier / 2.0f);
+
+  // A beat restarts the pulse, whichever frame it was reported in.
+  static uint64_t last_beats = 0;
+  static float pulse = 0.0f;
+  if (beat.beats != last_beats) {
+    last_beats = beat.beats;
+    pulse = 1.0f;
+  }
+  pulse *= std::exp(-FrameTime() * circle_options.pulse_decay);
+  float level =
+      circle_options.pulse_on_beat ? pulse : audio_buffer.avg_amplitude;
+
+  float outer_radius =
+      radius + std::max(level * circle_options.max_outer_radius, 1.0f);
+  static float rendered_radius = 0.0f;
+  rendered_radius += (outer_radius - rendered_radius) *
+                     SmoothingStep(circle_options.anim_smoothness);
+  float hue = circle_options.hue_start +
+              circle_options.hue_dynamic_range *
+                  (audio_buffer.avg_amplitude / audio_buffer.max_amplitude);
+
+  if (circle_options.enable_changing_hue)
+    hue += time * circle_options.changing_hue_speed;
+
+  float saturation = 1.0f;
+  float value = 1.0f;
+  Color color = ColorFromHSV(hue, saturation, value);
+  DrawRing(center, radius, rendered_radius, circle_options.start_angle_deg,
+           circle_options.end_angle_deg, circle_options.segments, color);
+}
+
+namespace {
+// What the wave was last picked and synthesized from, to skip both when
+// nothing they depend on changed.
+struct WaveCache {
+  std::array<audio::WaveComponent, audio::kMaxWaveComponents> components;
+  size_t count = 0;
+  // Options the components were picked with, wave_count -1 before the first.
+  int wave_count = -1;
+  bool interpolate_peaks = false;
+  float amplitude_mult = 0.0f;
+
+  const float *wave = nullptr;
+  float radians_per_hz = 0.0f;
+  float phase = 0.0f;
+  float damp_strength = 0.0f;
+};
+} // namespace
+
+void ComputeWavePoints(audio::ProcessedAudioView audio_buffer,
+                       const WaveOptions &wave_options, float start_x,
+                       float time, std::array<Vector2, drawable_width> &points,
+                       bool spectrum_changed) {
+  static WaveCache cache;
+  // The loudest components only depend on the spectrum and these options.
+  const bool repick =
+      spectrum_changed || wave_options.wave_count != cache.wave_count ||
+      wave_options.interpolate_peaks != cache.interpolate_peaks ||
+      wave_options.amplitude_mult != cache.amplitude_mult;
+  if (repick) {
+    cache.count = audio::loudestComponents(
+        audio_buffer, std::max(wave_options.wave_count, 0),
+        wave_options.interpolate_peaks, cache.components.data());
+    for (size_t c = 0; c < cache.count; c++)
+      cache.components[c].amplitude *= wave_options.amplitude_mult;
+    cache.wave_count = wave_options.wave_count;
+    cache.interpolate_peaks = wave_options.interpolate_peaks;
+    cache.amplitude_mult = wave_options.amplitude_mult;
+  }
+
+  static audio::WaveSynth synth;
+  const float radians_per_hz =
+      -2.0f * PI * wave_options.frequency_mult / sample_rate;
+  const float phase = time * wave_options.x_movement_speed;
+  // A wave that does not scroll stays put until the spectrum changes.
+  if (repick || cache.wave == nullptr ||
+      radians_per_hz != cache.radians_per_hz || phase != cache.phase ||
+      wave_options.damp_strength != cache.damp_strength) {
+    cache.wave = synth.Synthesize(cache.components.data(), cache.count,
+                                  radians_per_hz, phase,
+                                  wave_options.damp_strength, drawable_width);
+    cache.radians_per_hz = radians_per_hz;
+    cache.phase = phase;
+    cache.damp_strength = wave_options.damp_strength;
+  }
+  const float *wave = cache.wave;
+
+  for (int i = 0; i < drawable_width; i++)
+    points[i] = {.x = start_x + i, .y = wave[i]};
+}
+
+void RenderWave(audio::ProcessedAudioView audio_buffer,
+                WaveOptions wave_options, bool spectrum_changed) {
+  if (wave_options.disabled)
+    return;
+  float start_x = (GetRenderWidth() - drawable_width) / 2.0f;
+  static float time = 0.0f;
+  // Fully rewritten by ComputeWavePoints every frame.
+  static std::array<Vector2, drawable_width> points;
+
+  static std::array<Vector2, drawable_width> rendered_points{
+      GetRenderHeight() / 2.0f + wave_options.pos_y_offset};
+
+  time += FrameTime();
+
+  ComputeWavePoints(audio_buffer, wave_options, start_x, time, points,
+                    spectrum_changed);
+  const float step = SmoothingStep(wave_options.anim_smoothness);
+
+  Vector2 last_point = {
+      .x = start_x, .y = GetRenderHeight() / 2.0f + wave_options.pos_y_offset};
+
+  for (int i = 0; i < points.size(); i++) {
+    rendered_points[i].x = start_x + i;
+
+    rendered_points[i].y += (points[i].y - rendered_points[i].y) * step;
+    Vector2 current_point = {.x = rendered_points[i].x,
+                             .y = GetRenderHeight() / 2.0f +
+                                  wave_options.pos_y_offset +
+                                  rendered_points[i].y};
+
+    DrawLineEx(last_point, current_point, wave_options.thickness,
+               ColorFromHSV(wave_options.hue, 1.0f, 1.0f));
+    last_point = current_point;
+  }
+}
+
@@ -0,0 +1,100 @@
+#pragma once
+#include "processed-audio.h"
+#include "raylib.h"
+#include <array>
+#include <cstddef>
+#include <vector>
+
+static constexpr size_t drawable_width = 400;
+
+struct BarOptions {
+  bool disabled = false;
+  float inbetween_gap = 0.0f;
+  float height_mult = 180.0f;
+  float min_height = 10.0f;
+  float anim_smoothness = 40.0f;
+  float hue_start = 180.0f;
+  float hue_dynamic_range = 180.f;
+  float pos_y_offset = 100.0f;
+  bool enable_changing_hue = true;
+  float changing_hue_speed = 10.0f;
+  // Draw all bars with one shader pass instead of a rectangle per bar.
+  bool gpu = true;
+  // Darkening towards the bar ends, GPU path only.
+  float gradient = 0.0f;
+};
+
+struct CircleOptions {
+  bool disabled = false;
+  float radius_multiplier = 1.5f;
+  float max_outer_radius = 25.0f;
+  float anim_smoothness = 20.0f;
+  float hue_start = 300.0f;
+  float hue_dynamic_range = 1000.f;
+  bool enable_changing_hue = true;
+  float changing_hue_speed = 10.0f;
+  int segments = 100;
+  float start_angle_deg = 0.0f;
+  float end_angle_deg = 360.0f;
+  // Pulse on the tracked beats instead of following the average amplitude.
+  bool pulse_on_beat = false;
+  // Decay rate of a beat pulse, per second.
+  float pulse_decay = 6.0f;
+};
+
+struct WaveOptions {
+  bool disabled = false;
+  float anim_smoothness = 20.0f;
+  float hue = 60.0f;
+  float pos_y_offset = 100.0f;
+  int wave_count = 3;
+  float damp_strength = 200.0f;
+  float x_movement_speed = 10.f;
+  float amplitude_mult = 30.0f;
+  float frequency_mult = 2.0f;
+  float thickness = 5.0f;
+  // Refine the frequency of every component between FFT bins.
+  bool interpolate_peaks = true;
+};
+
+struct SpectrogramOptions {
+  bool disabled = true;
+  // Analysis frames kept on screen, one texture row each.
+  int history = 512;
+  // Every FFT bin up to max_bin instead of the band-mapped spectrum.
+  bool raw_bins = false;
+  int max_bin = 512;
+  // Levels this far below each frame's peak are drawn black.
+  float db_range = 60.0f;
+  // Height of the view, anchored to the bottom of the window.
+  float height = 300.0f;
+};
+
+// Advances the animations by a fixed step per rendered frame instead of the
+// measured frame time, for offline rendering. 0 restores the default.
+void SetAnimationTimeStep(float seconds);
+
+// spectrum_changed false promises the same spectrum as the previous call
+// (see FramePacer::Changed), so what was derived from it is reused: the bars
+// stop smoothing and uploading once settled, the wave keeps its components.
+void RenderBars(audio::ProcessedAudioView audio_buffer, BarOptions bar_options,
+                bool spectrum_changed = true);
+// Releases the GPU resources of the batched bar renderer, call before
+// CloseWindow.
+void UnloadBarRenderer();
+// Scrolling history of the mid spectrum. Each newly published frame adds one
+// row to a ring texture, the rest scrolls on the GPU.
+void RenderSpectrogram(const audio::ProcessedAudioFrame &frame,
+                       SpectrogramOptions spectrogram_options);
+// Releases the history texture and shader, call before CloseWindow.
+void UnloadSpectrogramRenderer();
+void RenderCircle(audio::ProcessedAudioView audio_buffer,
+                  const audio::BeatInfo &beat, CircleOptions circle_options);
+void RenderWave(audio::ProcessedAudioView audio_buffer,
+                WaveOptions wave_options, bool spectrum_changed = true);
+
+// CPU side of the renderers, exposed for benchmarking.
+void ComputeWavePoints(audio::ProcessedAudioView audio_buffer,
+                       const WaveOptions &wave_options, float start_x,
+                       float time, std::array<Vector2, drawable_width> &points,
+                       bool spectrum_changed = true);
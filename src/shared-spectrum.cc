@@ -0,0 +1,322 @@
+#include "shared-spectrum.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace audio {
+namespace {
+constexpr size_t kLine = 64;
+
+constexpr size_t alignUp(size_t bytes) {
+  return (bytes + kLine - 1) / kLine * kLine;
+}
+
+constexpr size_t kHeaderSize = alignUp(sizeof(SharedSpectrumHeader));
+
+// Byte offsets of the arrays within a slot.
+struct SlotLayout {
+  SlotLayout(size_t max_bins, size_t max_bands)
+      : bins_stride(alignUp(max_bins * sizeof(float))),
+        bands_stride(alignUp(max_bands * sizeof(float))) {}
+
+  size_t Frequencies() const { return alignUp(sizeof(SharedSpectrumSlot)); }
+  size_t Magnitudes(size_t row) const {
+    return Frequencies() + bins_stride + row * RowSize();
+  }
+  size_t BandAmplitudes(size_t row) const {
+    return Magnitudes(row) + bins_stride;
+  }
+  size_t BandFrequencies(size_t row) const {
+    return BandAmplitudes(row) + bands_stride;
+  }
+  size_t Size() const { return Magnitudes(kSharedRows); }
+
+  size_t RowSize() const { return bins_stride + 2 * bands_stride; }
+
+  size_t bins_stride;
+  size_t bands_stride;
+};
+
+void copyFloats(std::span<const float> from, float *to, size_t capacity) {
+  std::memcpy(to, from.data(), std::min(from.size(), capacity) * sizeof(float));
+}
+
+// True if the object under name was left behind: closed, or created by a
+// process that is gone. One that is still being set up, has another layout
+// or is not ours at all is left alone.
+bool abandoned(const std::string &name) {
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0)
+    return errno == ENOENT;
+  bool result = false;
+  struct stat st;
+  if (fstat(fd, &st) == 0 &&
+      static_cast<size_t>(st.st_size) >= sizeof(SharedSpectrumHeader)) {
+    void *mapping = mmap(nullptr, sizeof(SharedSpectrumHeader), PROT_READ,
+                         MAP_SHARED, fd, 0);
+    if (mapping != MAP_FAILED) {
+      const auto *header = static_cast<const SharedSpectrumHeader *>(mapping);
+      if (header->magic == kSharedSpectrumMagic &&
+          header->version == kSharedSpectrumVersion) {
+        result = header->state.load(std::memory_order_acquire) ==
+                     SharedSpectrumState::kClosed ||
+                 (header->writer_pid > 0 && kill(header->writer_pid, 0) != 0 &&
+                  errno == ESRCH);
+      }
+      munmap(mapping, sizeof(SharedSpectrumHeader));
+    }
+  }
+  close(fd);
+  return result;
+}
+} // namespace
+
+std::string sharedSpectrumName(std::string_view source, uint64_t serial,
+                               std::string_view role) {
+  std::string name = "/audio-visualizer-";
+  auto append = [&](std::string_view part) {
+    for (char c : part) {
+      bool allowed = std::isalnum(static_cast<unsigned char>(c)) || c == '-' ||
+                     c == '_' || c == '.';
+      name += allowed ? c : '_';
+    }
+  };
+  if (!role.empty()) {
+    append(role);
+    name += '-';
+  }
+  append(source);
+  if (serial != 0)
+    name += '-' + std::to_string(serial);
+  return name;
+}
+
+SharedSpectrumWriter::~SharedSpectrumWriter() { Close(); }
+
+void SharedSpectrumWriter::Close() {
+  if (mapping_ == nullptr)
+    return;
+  static_cast<SharedSpectrumHeader *>(mapping_)->state.store(
+      SharedSpectrumState::kClosed, std::memory_order_release);
+  munmap(mapping_, mapping_size_);
+  shm_unlink(name_.c_str());
+  mapping_ = nullptr;
+  mapping_size_ = 0;
+}
+
+bool SharedSpectrumWriter::Create(size_t sample_rate, size_t bins,
+                                  size_t bands) {
+  Close();
+  const SlotLayout layout(bins, bands);
+  const size_t slot_size = layout.Size();
+  const size_t size = kHeaderSize + slot_count_ * slot_size;
+
+  int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  // A writer that crashed leaves its object behind, readers still mapping it
+  // keep their copy. A live writer's object is not ours to take.
+  if (fd < 0 && errno == EEXIST && abandoned(name_)) {
+    shm_unlink(name_.c_str());
+    fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  }
+  if (fd < 0) {
+    fprintf(stderr, "shared spectrum: cannot create %s: %s\n", name_.c_str(),
+            std::strerror(errno));
+    return false;
+  }
+  void *mapping = MAP_FAILED;
+  if (ftruncate(fd, size) == 0)
+    mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    fprintf(stderr, "shared spectrum: cannot map %s: %s\n", name_.c_str(),
+            std::strerror(errno));
+    shm_unlink(name_.c_str());
+    return false;
+  }
+
+  // The object starts zeroed, which is also a valid initial state for every
+  // slot's sequence counter.
+  auto *header = new (mapping) SharedSpectrumHeader{};
+  header->magic = kSharedSpectrumMagic;
+  header->version = kSharedSpectrumVersion;
+  header->sample_rate = sample_rate;
+  header->slot_count = slot_count_;
+  header->slot_size = slot_size;
+  header->max_bins = bins;
+  header->max_bands = bands;
+  header->writer_pid = getpid();
+  header->state.store(SharedSpectrumState::kLive, std::memory_order_release);
+  mapping_ = mapping;
+  mapping_size_ = size;
+  return true;
+}
+
+void SharedSpectrumWriter::Write(const ProcessedAudioFrame &frame,
+                                 size_t sample_rate) {
+  if (failed_)
+    return;
+  const size_t bins = frame.mid.magnitudes.size();
+  const size_t bands = frame.mid.band_amplitudes.size();
+  auto *header = static_cast<SharedSpectrumHeader *>(mapping_);
+  if (header == nullptr || header->max_bins < bins ||
+      header->max_bands < bands || header->sample_rate != sample_rate) {
+    if (!Create(sample_rate, bins, bands)) {
+      failed_ = true;
+      return;
+    }
+    header = static_cast<SharedSpectrumHeader *>(mapping_);
+  }
+
+  const SlotLayout layout(header->max_bins, header->max_bands);
+  const uint64_t written = header->written.load(std::memory_order_relaxed);
+  char *base = static_cast<char *>(mapping_) + kHeaderSize +
+               (written % header->slot_count) * header->slot_size;
+  auto &slot = *reinterpret_cast<SharedSpectrumSlot *>(base);
+
+  const uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+  slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  const size_t channels = std::min(frame.channel_count, kMaxAnalysedChannels);
+  slot.channel_count = channels;
+  slot.frame = written;
+  slot.timing = frame.timing;
+  slot.beat = frame.beat;
+  slot.levels = frame.levels;
+  copyFloats(frame.mid.frequencies,
+             reinterpret_cast<float *>(base + layout.Frequencies()),
+             header->max_bins);
+  auto copy_row = [&](size_t row, const ProcessedAudioBuffer &buffer) {
+    slot.rows[row] = {
+        .bins = static_cast<uint32_t>(
+            std::min<size_t>(buffer.magnitudes.size(), header->max_bins)),
+        .bands = static_cast<uint32_t>(std::min<size_t>(
+            buffer.band_amplitudes.size(), header->max_bands)),
+        .max_amplitude = buffer.max_amplitude,
+        .avg_amplitude = buffer.avg_amplitude};
+    copyFloats(buffer.magnitudes,
+               reinterpret_cast<float *>(base + layout.Magnitudes(row)),
+               header->max_bins);
+    copyFloats(buffer.band_amplitudes,
+               reinterpret_cast<float *>(base + layout.BandAmplitudes(row)),
+               header->max_bands);
+    copyFloats(buffer.band_frequencies,
+               reinterpret_cast<float *>(base + layout.BandFrequencies(row)),
+               header->max_bands);
+  };
+  for (size_t c = 0; c < channels; ++c)
+    copy_row(c, frame.channels[c]);
+  copy_row(kSharedMidRow, frame.mid);
+  copy_row(kSharedSideRow, frame.side);
+
+  slot.sequence.store(sequence + 2, std::memory_order_release);
+  header->written.store(written + 1, std::memory_order_release);
+}
+
+bool SharedSpectrumReader::Open(const std::string &name) {
+  Close();
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  void *mapping = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && size_t(st.st_size) >= kHeaderSize)
+    mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+    return false;
+
+  const auto *header = static_cast<const SharedSpectrumHeader *>(mapping);
+  const bool usable =
+      header->state.load(std::memory_order_acquire) ==
+          SharedSpectrumState::kLive &&
+      header->magic == kSharedSpectrumMagic &&
+      header->version == kSharedSpectrumVersion && header->slot_count > 0 &&
+      header->slot_size >=
+          SlotLayout(header->max_bins, header->max_bands).Size() &&
+      size_t(st.st_size) >=
+          kHeaderSize + size_t(header->slot_count) * header->slot_size;
+  if (!usable) {
+    munmap(mapping, st.st_size);
+    return false;
+  }
+  header_ = header;
+  mapping_size_ = st.st_size;
+  return true;
+}
+
+void SharedSpectrumReader::Close() {
+  if (header_ == nullptr)
+    return;
+  munmap(const_cast<SharedSpectrumHeader *>(header_), mapping_size_);
+  header_ = nullptr;
+  mapping_size_ = 0;
+}
+
+bool SharedSpectrumReader::Closed() const {
+  return header_ == nullptr ||
+         header_->state.load(std::memory_order_acquire) ==
+             SharedSpectrumState::kClosed;
+}
+
+uint64_t SharedSpectrumReader::Written() const {
+  return header_ == nullptr
+             ? 0
+             : header_->written.load(std::memory_order_acquire);
+}
+
+const SharedSpectrumSlot &SharedSpectrumReader::Slot(uint64_t frame) const {
+  const char *base = reinterpret_cast<const char *>(header_) + kHeaderSize +
+                     (frame % header_->slot_count) * header_->slot_size;
+  return *reinterpret_cast<const SharedSpectrumSlot *>(base);
+}
+
+void SharedSpectrumReader::Fill(const SharedSpectrumSlot &slot,
+                                SharedFrameView &view) const {
+  // Counts are clamped to the capacity: a slot being overwritten may hold
+  // anything, but the spans must stay inside the mapping.
+  const SlotLayout layout(header_->max_bins, header_->max_bands);
+  const char *base = reinterpret_cast<const char *>(&slot);
+  auto floats = [&](size_t offset, size_t count, size_t capacity) {
+    return std::span<const float>(
+        reinterpret_cast<const float *>(base + offset),
+        std::min(count, capacity));
+  };
+  auto row = [&](size_t r) {
+    const SharedSpectrumRow &info = slot.rows[r];
+    ProcessedAudioView row;
+    row.magnitudes =
+        floats(layout.Magnitudes(r), info.bins, header_->max_bins);
+    row.frequencies =
+        floats(layout.Frequencies(), info.bins, header_->max_bins);
+    row.band_amplitudes =
+        floats(layout.BandAmplitudes(r), info.bands, header_->max_bands);
+    row.band_frequencies =
+        floats(layout.BandFrequencies(r), info.bands, header_->max_bands);
+    row.max_amplitude = info.max_amplitude;
+    row.avg_amplitude = info.avg_amplitude;
+    return row;
+  };
+
+  view.frame = slot.frame;
+  view.sample_rate = header_->sample_rate;
+  view.channel_count = std::min<size_t>(slot.channel_count,
+                                        kMaxAnalysedChannels);
+  view.timing = slot.timing;
+  view.beat = slot.beat;
+  view.levels = slot.levels;
+  for (size_t c = 0; c < view.channel_count; ++c)
+    view.channels[c] = row(c);
+  view.mid = row(kSharedMidRow);
+  view.side = row(kSharedSideRow);
+}
+
+} // namespace audio
@@ -0,0 +1,184 @@
+#pragma once
+#include "processed-audio.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace audio {
+
+// Analysis frames published through POSIX shared memory, so other processes
+// can display a source without capturing and analysing it themselves. Each
+// source gets its own object (see sharedSpectrumName) holding a small ring of
+// frame slots. There is one writer, the source's analysis thread, and any
+// number of readers. Readers map the object read-only and read the newest
+// slot in place. A per-slot sequence counter (a seqlock) tells them whether
+// the writer came round to that slot while they were reading it.
+//
+// The layout below is the wire format: any change to it, including to the
+// structs embedded in a slot, bumps kSharedSpectrumVersion.
+inline constexpr uint32_t kSharedSpectrumMagic = 0x50535641; // "AVSP"
+inline constexpr uint32_t kSharedSpectrumVersion = 2;
+// Channel rows, then mid and side.
+inline constexpr size_t kSharedRows = kMaxAnalysedChannels + 2;
+inline constexpr size_t kSharedMidRow = kMaxAnalysedChannels;
+inline constexpr size_t kSharedSideRow = kMaxAnalysedChannels + 1;
+
+enum class SharedSpectrumState : uint32_t {
+  kInitializing = 0,
+  kLive = 1,
+  // The writer went away or replaced the object, readers should reopen.
+  kClosed = 2,
+};
+
+struct SharedSpectrumHeader {
+  uint32_t magic;
+  uint32_t version;
+  std::atomic<SharedSpectrumState> state;
+  uint32_t sample_rate;
+  uint32_t slot_count;
+  // Bytes from one slot to the next, slots start after the header.
+  uint32_t slot_size;
+  // Capacity of every row, frames may use fewer.
+  uint32_t max_bins;
+  uint32_t max_bands;
+  // getpid() of the writer. A new writer only takes over an object left
+  // behind under its name if this process is gone or the object is closed.
+  int32_t writer_pid;
+  // Frames written so far, the newest is in slot (written - 1) % slot_count.
+  alignas(64) std::atomic<uint64_t> written;
+};
+
+struct SharedSpectrumRow {
+  uint32_t bins;
+  uint32_t bands;
+  float max_amplitude;
+  float avg_amplitude;
+};
+
+// Start of every slot. Followed by the float arrays, each starting on a cache
+// line: frequencies[max_bins], then per row magnitudes[max_bins],
+// band_amplitudes[max_bands] and band_frequencies[max_bands].
+struct SharedSpectrumSlot {
+  // Odd while the writer is filling the slot.
+  std::atomic<uint32_t> sequence;
+  uint32_t channel_count;
+  uint64_t frame;
+  FrameTiming timing;
+  BeatInfo beat;
+  LevelInfo levels;
+  SharedSpectrumRow rows[kSharedRows];
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free &&
+                  std::atomic<uint64_t>::is_always_lock_free,
+              "seqlock counters must work across processes");
+
+// "/audio-visualizer-[<role>-]<source>[-<serial>]", with characters shm_open
+// does not like in a name replaced. serial is the PipeWire node serial, 0 for
+// none; role tells apart the objects of captures of the same node with other
+// settings. Two live writers cannot share a name, see SharedSpectrumWriter.
+std::string sharedSpectrumName(std::string_view source, uint64_t serial = 0,
+                               std::string_view role = {});
+
+// Writer side, owned by the source's AudioProcessor and called from its
+// analysis thread. The object is created on the first frame, sized for it,
+// and recreated if a later frame does not fit. It is unlinked on destruction.
+// An object of the same name is only replaced when its writer closed it or
+// died, while another writer uses the name creating it fails.
+class SharedSpectrumWriter {
+public:
+  explicit SharedSpectrumWriter(std::string name, size_t slot_count = 4)
+      : name_(std::move(name)), slot_count_(slot_count) {}
+  ~SharedSpectrumWriter();
+
+  SharedSpectrumWriter(const SharedSpectrumWriter &) = delete;
+  SharedSpectrumWriter &operator=(const SharedSpectrumWriter &) = delete;
+
+  const std::string &Name() const { return name_; }
+  // Copies the frame into the next slot. Failing to create the object is
+  // reported once, frames are then dropped.
+  void Write(const ProcessedAudioFrame &frame, size_t sample_rate);
+
+private:
+  bool Create(size_t sample_rate, size_t bins, size_t bands);
+  void Close();
+
+  std::string name_;
+  size_t slot_count_;
+  bool failed_ = false;
+  void *mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+};
+
+// One published frame as seen by a reader, pointing into the shared mapping.
+// Only meaningful until the ReadLatest call that produced it returns.
+struct SharedFrameView {
+  uint64_t frame = 0;
+  size_t sample_rate = 0;
+  size_t channel_count = 0;
+  FrameTiming timing;
+  BeatInfo beat;
+  LevelInfo levels;
+  ProcessedAudioView channels[kMaxAnalysedChannels];
+  ProcessedAudioView mid;
+  ProcessedAudioView side;
+};
+
+// Reader side, usable from any process. Holds a read-only mapping of one
+// source's object.
+class SharedSpectrumReader {
+public:
+  SharedSpectrumReader() = default;
+  ~SharedSpectrumReader() { Close(); }
+
+  SharedSpectrumReader(const SharedSpectrumReader &) = delete;
+  SharedSpectrumReader &operator=(const SharedSpectrumReader &) = delete;
+
+  // Maps the named object, false if it does not exist (yet) or has another
+  // layout version. May be called again to reopen.
+  bool Open(const std::string &name);
+  void Close();
+  bool IsOpen() const { return header_ != nullptr; }
+  // The writer is gone or replaced the object: Open again.
+  bool Closed() const;
+  // Frames written so far, cheap enough to poll for new ones.
+  uint64_t Written() const;
+
+  // Calls read(const SharedFrameView &) on the newest frame in place, without
+  // copying it. read may see a frame being overwritten, whatever it computed
+  // must then be discarded: ReadLatest returns true only if the frame stayed
+  // intact throughout. Retries a few times before giving up.
+  template <typename Read> bool ReadLatest(Read &&read) const {
+    for (int attempt = 0; attempt < kAttempts; ++attempt) {
+      const uint64_t written = Written();
+      if (written == 0)
+        return false;
+      const SharedSpectrumSlot &slot = Slot(written - 1);
+      const uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+      if (sequence & 1)
+        continue;
+      SharedFrameView view;
+      Fill(slot, view);
+      read(static_cast<const SharedFrameView &>(view));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) == sequence)
+        return true;
+    }
+    return false;
+  }
+
+private:
+  static constexpr int kAttempts = 4;
+
+  const SharedSpectrumSlot &Slot(uint64_t frame) const;
+  void Fill(const SharedSpectrumSlot &slot, SharedFrameView &view) const;
+
+  const SharedSpectrumHeader *header_ = nullptr;
+  size_t mapping_size_ = 0;
+};
+
+} // namespace audio
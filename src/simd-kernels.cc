@@ -0,0 +1,344 @@
+#include "simd-kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AUDIO_KERNELS_X86 1
+#endif
+
+namespace audio {
+namespace {
+
+// Scalar versions double as the tails of the vector ones.
+
+void windowMultiplyScalar(const float *in, const float *window, float *out,
+                          size_t count) {
+  for (size_t i = 0; i < count; ++i)
+    out[i] = in[i] * window[i];
+}
+
+void complexMagnitudeScalar(const float *complex, float *out, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    float re = complex[2 * i];
+    float im = complex[2 * i + 1];
+    out[i] = std::sqrt(re * re + im * im);
+  }
+}
+
+MaxSum maxSumScalar(const float *in, size_t count) {
+  MaxSum result{0.0f, 0.0f};
+  for (size_t i = 0; i < count; ++i) {
+    result.max = std::max(result.max, in[i]);
+    result.sum += in[i];
+  }
+  return result;
+}
+
+void scaleScalar(float *data, size_t count, float factor) {
+  for (size_t i = 0; i < count; ++i)
+    data[i] *= factor;
+}
+
+void deinterleaveTail(const float *interleaved, size_t frames, size_t channels,
+                      float *const *planar, size_t from) {
+  for (size_t c = 0; c < channels; ++c) {
+    float *out = planar[c];
+    const float *in = interleaved + c;
+    for (size_t i = from; i < frames; ++i)
+      out[i] = in[i * channels];
+  }
+}
+
+void deinterleaveScalar(const float *interleaved, size_t frames,
+                        size_t channels, float *const *planar) {
+  deinterleaveTail(interleaved, frames, channels, planar, 0);
+}
+
+constexpr Kernels kScalar = {
+    .name = "scalar",
+    .window_multiply = windowMultiplyScalar,
+    .complex_magnitude = complexMagnitudeScalar,
+    .max_sum = maxSumScalar,
+    .scale = scaleScalar,
+    .deinterleave = deinterleaveScalar,
+};
+
+#if AUDIO_KERNELS_X86
+
+// SSE2
+
+__attribute__((target("sse2"))) void
+windowMultiplySse2(const float *in, const float *window, float *out,
+                   size_t count) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+    _mm_storeu_ps(out + i,
+                  _mm_mul_ps(_mm_loadu_ps(in + i), _mm_loadu_ps(window + i)));
+  windowMultiplyScalar(in + i, window + i, out + i, count - i);
+}
+
+__attribute__((target("sse2"))) void
+complexMagnitudeSse2(const float *complex, float *out, size_t count) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128 a = _mm_loadu_ps(complex + 2 * i);
+    __m128 b = _mm_loadu_ps(complex + 2 * i + 4);
+    a = _mm_mul_ps(a, a);
+    b = _mm_mul_ps(b, b);
+    __m128 re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    _mm_storeu_ps(out + i, _mm_sqrt_ps(_mm_add_ps(re, im)));
+  }
+  complexMagnitudeScalar(complex + 2 * i, out + i, count - i);
+}
+
+__attribute__((target("sse2"))) MaxSum maxSumSse2(const float *in,
+                                                  size_t count) {
+  __m128 vmax = _mm_setzero_ps();
+  __m128 vsum = _mm_setzero_ps();
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128 v = _mm_loadu_ps(in + i);
+    vmax = _mm_max_ps(vmax, v);
+    vsum = _mm_add_ps(vsum, v);
+  }
+  alignas(16) float maxes[4], sums[4];
+  _mm_store_ps(maxes, vmax);
+  _mm_store_ps(sums, vsum);
+  MaxSum tail = maxSumScalar(in + i, count - i);
+  return {std::max({maxes[0], maxes[1], maxes[2], maxes[3], tail.max}),
+          sums[0] + sums[1] + sums[2] + sums[3] + tail.sum};
+}
+
+__attribute__((target("sse2"))) void scaleSse2(float *data, size_t count,
+                                               float factor) {
+  __m128 f = _mm_set1_ps(factor);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+    _mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i), f));
+  scaleScalar(data + i, count - i, factor);
+}
+
+// LRLRLRLR -> LLLL RRRR, four frames per iteration.
+__attribute__((target("sse2"))) void
+deinterleaveSse2(const float *interleaved, size_t frames, size_t channels,
+                 float *const *planar) {
+  size_t i = 0;
+  if (channels == 2) {
+    float *left = planar[0];
+    float *right = planar[1];
+    for (; i + 4 <= frames; i += 4) {
+      __m128 a = _mm_loadu_ps(interleaved + 2 * i);
+      __m128 b = _mm_loadu_ps(interleaved + 2 * i + 4);
+      _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+      _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+  }
+  deinterleaveTail(interleaved, frames, channels, planar, i);
+}
+
+constexpr Kernels kSse2 = {
+    .name = "sse2",
+    .window_multiply = windowMultiplySse2,
+    .complex_magnitude = complexMagnitudeSse2,
+    .max_sum = maxSumSse2,
+    .scale = scaleSse2,
+    .deinterleave = deinterleaveSse2,
+};
+
+// AVX2
+
+__attribute__((target("avx2"))) void
+windowMultiplyAvx2(const float *in, const float *window, float *out,
+                   size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+    _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps(in + i),
+                                            _mm256_loadu_ps(window + i)));
+  windowMultiplyScalar(in + i, window + i, out + i, count - i);
+}
+
+__attribute__((target("avx2"))) void
+complexMagnitudeAvx2(const float *complex, float *out, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256 a = _mm256_loadu_ps(complex + 2 * i);
+    __m256 b = _mm256_loadu_ps(complex + 2 * i + 8);
+    // Per 128 bit lane: a0+a1 a2+a3 b0+b1 b2+b3, then restore bin order.
+    __m256 sums = _mm256_hadd_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(b, b));
+    sums = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(sums),
+                                                  _MM_SHUFFLE(3, 1, 2, 0)));
+    _mm256_storeu_ps(out + i, _mm256_sqrt_ps(sums));
+  }
+  complexMagnitudeScalar(complex + 2 * i, out + i, count - i);
+}
+
+__attribute__((target("avx2"))) MaxSum maxSumAvx2(const float *in,
+                                                  size_t count) {
+  __m256 vmax = _mm256_setzero_ps();
+  __m256 vsum = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256 v = _mm256_loadu_ps(in + i);
+    vmax = _mm256_max_ps(vmax, v);
+    vsum = _mm256_add_ps(vsum, v);
+  }
+  alignas(32) float maxes[8], sums[8];
+  _mm256_store_ps(maxes, vmax);
+  _mm256_store_ps(sums, vsum);
+  MaxSum result = maxSumScalar(in + i, count - i);
+  for (int lane = 0; lane < 8; ++lane) {
+    result.max = std::max(result.max, maxes[lane]);
+    result.sum += sums[lane];
+  }
+  return result;
+}
+
+__attribute__((target("avx2"))) void scaleAvx2(float *data, size_t count,
+                                               float factor) {
+  __m256 f = _mm256_set1_ps(factor);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+    _mm256_storeu_ps(data + i, _mm256_mul_ps(_mm256_loadu_ps(data + i), f));
+  scaleScalar(data + i, count - i, factor);
+}
+
+__attribute__((target("avx2"))) void
+deinterleaveAvx2(const float *interleaved, size_t frames, size_t channels,
+                 float *const *planar) {
+  size_t i = 0;
+  if (channels == 2) {
+    float *left = planar[0];
+    float *right = planar[1];
+    for (; i + 8 <= frames; i += 8) {
+      __m256 a = _mm256_loadu_ps(interleaved + 2 * i);
+      __m256 b = _mm256_loadu_ps(interleaved + 2 * i + 8);
+      __m256 l = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+      __m256 r = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+      _mm256_storeu_ps(left + i,
+                       _mm256_castpd_ps(_mm256_permute4x64_pd(
+                           _mm256_castps_pd(l), _MM_SHUFFLE(3, 1, 2, 0))));
+      _mm256_storeu_ps(right + i,
+                       _mm256_castpd_ps(_mm256_permute4x64_pd(
+                           _mm256_castps_pd(r), _MM_SHUFFLE(3, 1, 2, 0))));
+    }
+  }
+  deinterleaveTail(interleaved, frames, channels, planar, i);
+}
+
+constexpr Kernels kAvx2 = {
+    .name = "avx2",
+    .window_multiply = windowMultiplyAvx2,
+    .complex_magnitude = complexMagnitudeAvx2,
+    .max_sum = maxSumAvx2,
+    .scale = scaleAvx2,
+    .deinterleave = deinterleaveAvx2,
+};
+
+// AVX-512, deinterleave stays on the AVX2 kernel, it is memory bound.
+
+__attribute__((target("avx512f"))) void
+windowMultiplyAvx512(const float *in, const float *window, float *out,
+                     size_t count) {
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16)
+    _mm512_storeu_ps(out + i, _mm512_mul_ps(_mm512_loadu_ps(in + i),
+                                            _mm512_loadu_ps(window + i)));
+  windowMultiplyScalar(in + i, window + i, out + i, count - i);
+}
+
+__attribute__((target("avx512f"))) void
+complexMagnitudeAvx512(const float *complex, float *out, size_t count) {
+  const __m512i even = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18,
+                                         20, 22, 24, 26, 28, 30);
+  const __m512i odd = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21,
+                                        23, 25, 27, 29, 31);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m512 a = _mm512_loadu_ps(complex + 2 * i);
+    __m512 b = _mm512_loadu_ps(complex + 2 * i + 16);
+    a = _mm512_mul_ps(a, a);
+    b = _mm512_mul_ps(b, b);
+    __m512 re = _mm512_permutex2var_ps(a, even, b);
+    __m512 im = _mm512_permutex2var_ps(a, odd, b);
+    _mm512_storeu_ps(out + i, _mm512_sqrt_ps(_mm512_add_ps(re, im)));
+  }
+  complexMagnitudeScalar(complex + 2 * i, out + i, count - i);
+}
+
+__attribute__((target("avx512f"))) MaxSum maxSumAvx512(const float *in,
+                                                      size_t count) {
+  __m512 vmax = _mm512_setzero_ps();
+  __m512 vsum = _mm512_setzero_ps();
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m512 v = _mm512_loadu_ps(in + i);
+    vmax = _mm512_max_ps(vmax, v);
+    vsum = _mm512_add_ps(vsum, v);
+  }
+  MaxSum tail = maxSumScalar(in + i, count - i);
+  return {std::max(_mm512_reduce_max_ps(vmax), tail.max),
+          _mm512_reduce_add_ps(vsum) + tail.sum};
+}
+
+__attribute__((target("avx512f"))) void scaleAvx512(float *data, size_t count,
+                                                   float factor) {
+  __m512 f = _mm512_set1_ps(factor);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16)
+    _mm512_storeu_ps(data + i, _mm512_mul_ps(_mm512_loadu_ps(data + i), f));
+  scaleScalar(data + i, count - i, factor);
+}
+
+constexpr Kernels kAvx512 = {
+    .name = "avx512",
+    .window_multiply = windowMultiplyAvx512,
+    .complex_magnitude = complexMagnitudeAvx512,
+    .max_sum = maxSumAvx512,
+    .scale = scaleAvx512,
+    .deinterleave = deinterleaveAvx2,
+};
+
+#endif // AUDIO_KERNELS_X86
+
+const Kernels &selectKernels() {
+  const char *cap = std::getenv("AUDIO_VISUALIZER_SIMD");
+  auto allowed = [&](const char *name) {
+    if (cap == nullptr)
+      return true;
+    // The cap names the best allowed table, anything below it is fine too.
+    static constexpr const char *order[] = {"scalar", "sse2", "avx2",
+                                            "avx512"};
+    int cap_rank = -1, rank = -1;
+    for (int i = 0; i < 4; ++i) {
+      if (std::strcmp(order[i], cap) == 0)
+        cap_rank = i;
+      if (std::strcmp(order[i], name) == 0)
+        rank = i;
+    }
+    return cap_rank < 0 || rank <= cap_rank;
+  };
+
+#if AUDIO_KERNELS_X86
+  __builtin_cpu_init();
+  if (allowed("avx512") && __builtin_cpu_supports("avx512f") &&
+      __builtin_cpu_supports("avx2"))
+    return kAvx512;
+  if (allowed("avx2") && __builtin_cpu_supports("avx2"))
+    return kAvx2;
+  if (allowed("sse2") && __builtin_cpu_supports("sse2"))
+    return kSse2;
+#endif
+  return kScalar;
+}
+
+} // namespace
+
+const Kernels &kernels() {
+  static const Kernels &selected = selectKernels();
+  return selected;
+}
+
+} // namespace audio
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+
+namespace audio {
+
+struct MaxSum {
+  float max;
+  float sum;
+};
+
+// Hot loops of the analysis path. One table per instruction set, the best
+// one the cpu supports is picked on first use. Setting
+// AUDIO_VISUALIZER_SIMD=scalar|sse2|avx2|avx512 caps the selection, which is
+// handy to compare implementations.
+struct Kernels {
+  const char *name;
+  // out[i] = in[i] * window[i], out may alias in.
+  void (*window_multiply)(const float *in, const float *window, float *out,
+                          size_t count);
+  // out[i] = |complex[i]| for interleaved re/im pairs (fftwf_complex).
+  void (*complex_magnitude)(const float *complex, float *out, size_t count);
+  MaxSum (*max_sum)(const float *in, size_t count);
+  void (*scale)(float *data, size_t count, float factor);
+  // planar[c][i] = interleaved[i * channels + c] for every channel.
+  void (*deinterleave)(const float *interleaved, size_t frames,
+                       size_t channels, float *const *planar);
+};
+
+const Kernels &kernels();
+
+inline void deinterleave(const float *interleaved, size_t frames,
+                         size_t channels, float *const *planar) {
+  kernels().deinterleave(interleaved, frames, channels, planar);
+}
+
+} // namespace audio
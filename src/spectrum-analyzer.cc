@@ -0,0 +1,81 @@
+#include "spectrum-analyzer.h"
+
+namespace audio {
+namespace {
+
+template <size_t fft_size, size_t channels>
+class FixedSpectrumAnalyzer final : public SpectrumAnalyzer {
+public:
+  explicit FixedSpectrumAnalyzer(FftOptions options) : options_(options) {}
+
+  size_t WindowSize() const override { return fft_size; }
+  size_t Channels() const override { return channels; }
+
+  void Analyze(const StftFrame &frame, size_t sample_rate,
+               ProcessedAudioFrame &output) override {
+    computeFFTMultichannelFixed<fft_size, channels>(frame, sample_rate, output,
+                                                   options_);
+  }
+
+private:
+  FftOptions options_;
+};
+
+class DynamicSpectrumAnalyzer final : public SpectrumAnalyzer {
+public:
+  DynamicSpectrumAnalyzer(size_t window_size, size_t channels,
+                          FftOptions options)
+      : window_size_(window_size), channels_(channels), options_(options) {}
+
+  size_t WindowSize() const override { return window_size_; }
+  size_t Channels() const override { return channels_; }
+
+  void Analyze(const StftFrame &frame, size_t sample_rate,
+               ProcessedAudioFrame &output) override {
+    computeFFTMultichannel(frame, sample_rate, output, options_);
+  }
+
+private:
+  size_t window_size_;
+  size_t channels_;
+  FftOptions options_;
+};
+
+template <size_t fft_size>
+std::unique_ptr<SpectrumAnalyzer> makeFixed(size_t channels,
+                                            FftOptions options) {
+  switch (channels) {
+  case 1:
+    return std::make_unique<FixedSpectrumAnalyzer<fft_size, 1>>(options);
+  case 2:
+    return std::make_unique<FixedSpectrumAnalyzer<fft_size, 2>>(options);
+  }
+  return nullptr;
+}
+
+} // namespace
+
+std::unique_ptr<SpectrumAnalyzer>
+makeSpectrumAnalyzer(size_t window_size, size_t channels, FftOptions options) {
+  std::unique_ptr<SpectrumAnalyzer> fixed;
+  switch (window_size) {
+  case 1024:
+    fixed = makeFixed<1024>(channels, options);
+    break;
+  case 2048:
+    fixed = makeFixed<2048>(channels, options);
+    break;
+  case 4096:
+    fixed = makeFixed<4096>(channels, options);
+    break;
+  case 8192:
+    fixed = makeFixed<8192>(channels, options);
+    break;
+  }
+  if (fixed)
+    return fixed;
+  return std::make_unique<DynamicSpectrumAnalyzer>(window_size, channels,
+                                                   options);
+}
+
+} // namespace audio
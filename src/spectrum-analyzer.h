@@ -0,0 +1,29 @@
+#pragma once
+#include "audio-processing.h"
+#include "processed-audio.h"
+#include "stft.h"
+#include <cstddef>
+#include <memory>
+
+namespace audio {
+
+// Multichannel spectrum analysis behind one interface whatever the window
+// size and channel count. Sizes in kFixedFftSizes with a channel count in
+// kFixedChannelCounts run the compile-time specialised
+// computeFFTMultichannelFixed, anything else computeFFTMultichannel.
+class SpectrumAnalyzer {
+public:
+  virtual ~SpectrumAnalyzer() = default;
+  virtual size_t WindowSize() const = 0;
+  // Analysed channels, at most kMaxAnalysedChannels.
+  virtual size_t Channels() const = 0;
+  // frame holds WindowSize() samples of Channels() analysed channels.
+  virtual void Analyze(const StftFrame &frame, size_t sample_rate,
+                       ProcessedAudioFrame &output) = 0;
+};
+
+std::unique_ptr<SpectrumAnalyzer>
+makeSpectrumAnalyzer(size_t window_size, size_t channels,
+                     FftOptions options = FftOptions{});
+
+} // namespace audio
@@ -0,0 +1,74 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace audio {
+
+// Wait-free single producer / single consumer ring of trivially copyable
+// elements. Capacity is rounded up to a power of two. Write and Read never
+// block and never allocate, so Write is safe to call from the PipeWire
+// real-time thread.
+template <typename T> class SpscRing {
+public:
+  explicit SpscRing(size_t capacity)
+      : buffer_(std::bit_ceil(std::max<size_t>(capacity, 2))),
+        mask_(buffer_.size() - 1) {}
+
+  size_t Capacity() const { return buffer_.size(); }
+
+  size_t ReadAvailable() const {
+    return head_.load(std::memory_order_acquire) -
+           tail_.load(std::memory_order_relaxed);
+  }
+
+  // Producer side only.
+  size_t WriteAvailable() const {
+    return Capacity() - (head_.load(std::memory_order_relaxed) -
+                         tail_.load(std::memory_order_acquire));
+  }
+
+  // Returns how many elements were written, elements that do not fit are not
+  // written.
+  size_t Write(const T *data, size_t count) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    const size_t tail = tail_.load(std::memory_order_acquire);
+    const size_t writable = std::min(count, Capacity() - (head - tail));
+    for (size_t i = 0; i < writable; ++i)
+      buffer_[(head + i) & mask_] = data[i];
+    head_.store(head + writable, std::memory_order_release);
+    return writable;
+  }
+
+  size_t Read(T *data, size_t count) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t head = head_.load(std::memory_order_acquire);
+    const size_t readable = std::min(count, head - tail);
+    for (size_t i = 0; i < readable; ++i)
+      data[i] = buffer_[(tail + i) & mask_];
+    tail_.store(tail + readable, std::memory_order_release);
+    return readable;
+  }
+
+  // Consumer side only. Drops up to count of the oldest elements unread,
+  // returns how many were dropped.
+  size_t Skip(size_t count) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t head = head_.load(std::memory_order_acquire);
+    const size_t skipped = std::min(count, head - tail);
+    tail_.store(tail + skipped, std::memory_order_release);
+    return skipped;
+  }
+
+private:
+  std::vector<T> buffer_;
+  size_t mask_;
+  // Producer and consumer indices on separate cache lines.
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+};
+
+} // namespace audio
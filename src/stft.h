@@ -0,0 +1,126 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace audio {
+
+struct StftOptions {
+  // FFT size, fixed regardless of the PipeWire quantum.
+  size_t window_size = 4096;
+  // Samples between two consecutive frames, window_size / 4 is 75% overlap.
+  size_t hop_size = 1024;
+};
+
+// Non-owning view of one analysis window, one contiguous row of size samples
+// per channel.
+struct StftFrame {
+  const float *const *channels;
+  size_t channel_count;
+  size_t size;
+  // Samples per channel that were not in the previous frame, at the end of
+  // each row. 0 if unknown, then every frame counts as new.
+  size_t new_samples = 0;
+  // CLOCK_MONOTONIC capture time of the newest sample, 0 if unknown.
+  int64_t capture_ns = 0;
+  // Input was skipped before this frame (see Stft::Restart), it does not
+  // follow on from the previous one. Stateful consumers should start over
+  // instead of treating the two as continuous.
+  bool discontinuity = false;
+};
+
+// Sliding window over the incoming planar samples. Push may be called with
+// chunks of any length, a frame of the last window_size samples (oldest
+// first) of every channel is emitted every hop_size samples.
+class Stft {
+public:
+  explicit Stft(StftOptions options, size_t channels = 1)
+      : window_size_(std::max<size_t>(options.window_size, 2)),
+        hop_size_(std::clamp<size_t>(options.hop_size, 1, window_size_)),
+        channels_(std::max<size_t>(channels, 1)),
+        history_(channels_ * 2 * window_size_), rows_(channels_),
+        until_next_frame_(window_size_) {}
+
+  size_t WindowSize() const { return window_size_; }
+  size_t HopSize() const { return hop_size_; }
+  size_t Channels() const { return channels_; }
+  // Samples per channel pushed so far. Inside on_frame, the index one past
+  // the frame's newest sample.
+  uint64_t SamplesPushed() const { return samples_pushed_; }
+
+  // Forgets the history without allocating, for input that skips ahead. The
+  // next frame comes once a whole window of new samples is in, flagged as a
+  // discontinuity. SamplesPushed keeps counting.
+  void Restart() {
+    std::fill(history_.begin(), history_.end(), 0.0f);
+    write_pos_ = 0;
+    until_next_frame_ = window_size_;
+    last_frame_end_ = samples_pushed_;
+    discontinuity_ = true;
+  }
+
+  // planar[c] holds count samples of channel c. on_frame(const StftFrame &)
+  // is called with rows that stay valid until the next call to Push.
+  template <typename OnFrame>
+  void Push(const float *const *planar, size_t count, OnFrame &&on_frame) {
+    size_t done = 0;
+    while (done < count) {
+      size_t n = std::min(count - done, until_next_frame_);
+      Append(planar, done, n);
+      done += n;
+      samples_pushed_ += n;
+      until_next_frame_ -= n;
+      if (until_next_frame_ == 0) {
+        until_next_frame_ = hop_size_;
+        for (size_t c = 0; c < channels_; ++c)
+          rows_[c] = Row(c) + write_pos_;
+        on_frame(StftFrame{
+            .channels = rows_.data(),
+            .channel_count = channels_,
+            .size = window_size_,
+            .new_samples = static_cast<size_t>(std::min<uint64_t>(
+                samples_pushed_ - last_frame_end_, window_size_)),
+            .discontinuity = discontinuity_});
+        discontinuity_ = false;
+        last_frame_end_ = samples_pushed_;
+      }
+    }
+  }
+
+private:
+  float *Row(size_t channel) {
+    return history_.data() + channel * 2 * window_size_;
+  }
+
+  void Append(const float *const *planar, size_t offset, size_t count) {
+    size_t pos = write_pos_;
+    for (size_t c = 0; c < channels_; ++c) {
+      float *row = Row(c);
+      const float *in = planar[c] + offset;
+      pos = write_pos_;
+      // Every sample is stored twice, window_size apart, so the most recent
+      // window is always contiguous at row[write_pos_].
+      for (size_t i = 0; i < count; ++i) {
+        row[pos] = in[i];
+        row[pos + window_size_] = in[i];
+        if (++pos == window_size_)
+          pos = 0;
+      }
+    }
+    write_pos_ = pos;
+  }
+
+  size_t window_size_;
+  size_t hop_size_;
+  size_t channels_;
+  std::vector<float> history_;
+  std::vector<const float *> rows_;
+  size_t write_pos_ = 0;
+  size_t until_next_frame_;
+  uint64_t samples_pushed_ = 0;
+  uint64_t last_frame_end_ = 0;
+  bool discontinuity_ = false;
+};
+
+} // namespace audio
@@ -0,0 +1,116 @@
+#include "synth-reader.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+namespace audio {
+
+SynthReader::SynthReader(SynthOptions options)
+    : options_(std::move(options)),
+      total_(static_cast<uint64_t>(options_.duration_seconds *
+                                   options_.format.sample_rate)),
+      phases_(options_.frequencies.size(), 0.0),
+      rng_(options_.seed ? options_.seed : 1) {}
+
+std::unique_ptr<SynthReader> SynthReader::FromSpec(const std::string &spec,
+                                                   StreamFormat format,
+                                                   float duration_seconds) {
+  SynthOptions options{.format = format,
+                       .duration_seconds = duration_seconds};
+  std::string kind = spec.substr(0, spec.find(':'));
+  std::string args = spec.size() > kind.size() ? spec.substr(kind.size() + 1)
+                                                : std::string();
+  // Arguments may be separated by ',' or ':'.
+  std::replace(args.begin(), args.end(), ':', ',');
+  std::vector<float> values;
+  std::stringstream stream(args);
+  for (std::string item; std::getline(stream, item, ',');)
+    values.push_back(std::strtof(item.c_str(), nullptr));
+
+  if (kind == "sine") {
+    options.kind = SynthKind::kSines;
+    if (!values.empty())
+      options.frequencies = values;
+  } else if (kind == "sweep") {
+    options.kind = SynthKind::kSweep;
+    if (values.size() > 0)
+      options.sweep_start = values[0];
+    if (values.size() > 1)
+      options.sweep_end = values[1];
+    if (values.size() > 2)
+      options.sweep_seconds = values[2];
+  } else if (kind == "noise") {
+    options.kind = SynthKind::kWhiteNoise;
+  } else if (kind == "pink") {
+    options.kind = SynthKind::kPinkNoise;
+  } else {
+    return nullptr;
+  }
+  return std::make_unique<SynthReader>(std::move(options));
+}
+
+size_t SynthReader::Read(float *interleaved, size_t frames) {
+  if (total_ > 0)
+    frames = std::min<uint64_t>(frames, total_ - produced_);
+  const size_t channels = options_.format.channels;
+  for (size_t i = 0; i < frames; ++i) {
+    float sample = NextSample();
+    for (size_t c = 0; c < channels; ++c)
+      interleaved[i * channels + c] = sample;
+    ++produced_;
+  }
+  return frames;
+}
+
+float SynthReader::NextWhite() {
+  // xorshift32, uniform in [-1, 1).
+  rng_ ^= rng_ << 13;
+  rng_ ^= rng_ >> 17;
+  rng_ ^= rng_ << 5;
+  return static_cast<int32_t>(rng_) / 2147483648.0f;
+}
+
+float SynthReader::NextSample() {
+  const double rate = options_.format.sample_rate;
+  switch (options_.kind) {
+  case SynthKind::kSines: {
+    float sum = 0.0f;
+    for (size_t p = 0; p < phases_.size(); ++p) {
+      sum += std::sin(phases_[p]);
+      phases_[p] = std::fmod(
+          phases_[p] + 2.0 * M_PI * options_.frequencies[p] / rate, 2.0 * M_PI);
+    }
+    return phases_.empty() ? 0.0f
+                           : options_.amplitude * sum / phases_.size();
+  }
+  case SynthKind::kSweep: {
+    double t = std::fmod(produced_ / rate, options_.sweep_seconds);
+    double freq = options_.sweep_start *
+                  std::pow(options_.sweep_end / options_.sweep_start,
+                           t / options_.sweep_seconds);
+    sweep_phase_ = std::fmod(sweep_phase_ + 2.0 * M_PI * freq / rate,
+                             2.0 * M_PI);
+    return options_.amplitude * std::sin(sweep_phase_);
+  }
+  case SynthKind::kWhiteNoise:
+    return options_.amplitude * NextWhite();
+  case SynthKind::kPinkNoise: {
+    float white = NextWhite();
+    float *b = pink_;
+    b[0] = 0.99886f * b[0] + white * 0.0555179f;
+    b[1] = 0.99332f * b[1] + white * 0.0750759f;
+    b[2] = 0.96900f * b[2] + white * 0.1538520f;
+    b[3] = 0.86650f * b[3] + white * 0.3104856f;
+    b[4] = 0.55000f * b[4] + white * 0.5329522f;
+    b[5] = -0.7616f * b[5] - white * 0.0168980f;
+    float pink = b[0] + b[1] + b[2] + b[3] + b[4] + b[5] + b[6] +
+                 white * 0.5362f;
+    b[6] = white * 0.115926f;
+    return options_.amplitude * pink * 0.11f;
+  }
+  }
+  return 0.0f;
+}
+
+} // namespace audio
@@ -0,0 +1,56 @@
+#pragma once
+#include "input-source.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace audio {
+
+enum class SynthKind { kSines, kSweep, kWhiteNoise, kPinkNoise };
+
+struct SynthOptions {
+  SynthKind kind = SynthKind::kSines;
+  StreamFormat format;
+  // kSines: one partial per entry, amplitudes split evenly.
+  std::vector<float> frequencies = {440.0f};
+  // kSweep: exponential sweep from start to end frequency, then restart.
+  float sweep_start = 20.0f;
+  float sweep_end = 20000.0f;
+  float sweep_seconds = 10.0f;
+  float amplitude = 0.5f;
+  // Stops after this long, 0 keeps generating forever.
+  float duration_seconds = 0.0f;
+  uint32_t seed = 1;
+};
+
+// Deterministic test signals, the same options always produce the same
+// samples. Every channel carries the same signal.
+class SynthReader : public SampleReader {
+public:
+  explicit SynthReader(SynthOptions options);
+
+  // "sine:440,880", "sweep:20:20000:10", "noise" or "pink". Returns nullptr
+  // for anything else.
+  static std::unique_ptr<SynthReader> FromSpec(const std::string &spec,
+                                               StreamFormat format,
+                                               float duration_seconds);
+
+  StreamFormat Format() const override { return options_.format; }
+  size_t Read(float *interleaved, size_t frames) override;
+
+private:
+  float NextSample();
+  float NextWhite();
+
+  SynthOptions options_;
+  uint64_t produced_ = 0;
+  uint64_t total_ = 0;
+  std::vector<double> phases_;
+  double sweep_phase_ = 0.0;
+  uint32_t rng_;
+  // Paul Kellet's pink noise filter state.
+  float pink_[7] = {};
+};
+
+} // namespace audio
@@ -0,0 +1,50 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace audio {
+
+// Wait-free publication of the latest complete value from one producer to one
+// consumer. The producer fills WriteBuffer() and Publish()es it, the consumer
+// gets the most recent published value from Read(). Neither side copies,
+// locks or ever waits for the other: the three slots are only exchanged by
+// swapping indices.
+template <typename T> class TripleBuffer {
+public:
+  template <typename... Args>
+  explicit TripleBuffer(const Args &...args)
+      : slots_{T(args...), T(args...), T(args...)} {}
+
+  // Producer side.
+  T &WriteBuffer() { return slots_[back_]; }
+
+  void Publish() {
+    back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) &
+            kIndexMask;
+  }
+
+  // Consumer side. The returned reference stays untouched by the producer
+  // until the next call to Read.
+  const T &Read() {
+    if (middle_.load(std::memory_order_relaxed) & kFresh)
+      front_ = middle_.exchange(front_, std::memory_order_acq_rel) &
+               kIndexMask;
+    return slots_[front_];
+  }
+
+  bool HasFresh() const {
+    return middle_.load(std::memory_order_relaxed) & kFresh;
+  }
+
+private:
+  static constexpr uint8_t kIndexMask = 0x3;
+  static constexpr uint8_t kFresh = 0x4;
+
+  std::array<T, 3> slots_;
+  uint8_t back_ = 0;
+  alignas(64) std::atomic<uint8_t> middle_{1};
+  alignas(64) uint8_t front_ = 2;
+};
+
+} // namespace audio
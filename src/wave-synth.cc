@@ -0,0 +1,125 @@
+#include "wave-synth.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+namespace audio {
+namespace {
+
+struct Candidate {
+  float amplitude;
+  uint32_t bin;
+};
+
+// Orders the heap with the quietest candidate at the front.
+bool louder(const Candidate &a, const Candidate &b) {
+  return a.amplitude > b.amplitude;
+}
+
+// Rotating a phasor accumulates rounding error, it is recomputed exactly
+// this often.
+constexpr size_t kResyncInterval = 256;
+
+} // namespace
+
+size_t loudestComponents(ProcessedAudioView buffer, size_t k,
+                         bool interpolate, WaveComponent *out) {
+  k = std::min(k, kMaxWaveComponents);
+  const auto magnitudes = buffer.magnitudes;
+  const auto frequencies = buffer.frequencies;
+  // Buffers not analysed yet have no frequency table.
+  if (k == 0 || magnitudes.empty() || frequencies.size() < magnitudes.size())
+    return 0;
+
+  std::array<Candidate, kMaxWaveComponents> heap;
+  size_t size = 0;
+  for (size_t i = 0; i < magnitudes.size(); ++i) {
+    const float amplitude = magnitudes[i];
+    if (size < k) {
+      if (amplitude <= 0.0f)
+        continue;
+      heap[size++] = {amplitude, static_cast<uint32_t>(i)};
+      std::push_heap(heap.begin(), heap.begin() + size, louder);
+    } else if (amplitude > heap[0].amplitude) {
+      std::pop_heap(heap.begin(), heap.begin() + size, louder);
+      heap[size - 1] = {amplitude, static_cast<uint32_t>(i)};
+      std::push_heap(heap.begin(), heap.begin() + size, louder);
+    }
+  }
+  // Loudest first.
+  std::sort_heap(heap.begin(), heap.begin() + size, louder);
+
+  for (size_t j = 0; j < size; ++j) {
+    const uint32_t bin = heap[j].bin;
+    float amplitude = heap[j].amplitude;
+    float offset = 0.0f;
+    if (interpolate && bin > 0 && bin + 1 < magnitudes.size()) {
+      const float left = magnitudes[bin - 1];
+      const float right = magnitudes[bin + 1];
+      const float curvature = left - 2.0f * amplitude + right;
+      if (curvature < 0.0f) {
+        offset = std::clamp(0.5f * (left - right) / curvature, -0.5f, 0.5f);
+        amplitude -= 0.25f * (left - right) * offset;
+      }
+    }
+    // Bins need not be evenly spaced (multi-resolution spectra), step
+    // towards the neighbour on the side of the offset.
+    float frequency = frequencies[bin];
+    if (offset > 0.0f)
+      frequency += offset * (frequencies[bin + 1] - frequency);
+    else if (offset < 0.0f)
+      frequency += offset * (frequency - frequencies[bin - 1]);
+    out[j] = {.amplitude = amplitude, .frequency = frequency};
+  }
+  return size;
+}
+
+void WaveSynth::UpdateEnvelope(float damp_points, size_t points) {
+  if (envelope_.size() == points && damp_points_ == damp_points)
+    return;
+  damp_points_ = damp_points;
+  envelope_.resize(points);
+  const float inv_damp = damp_points > 0.0f ? 1.0f / damp_points : 0.0f;
+  for (size_t i = 0; i < points; ++i) {
+    const size_t distance = i < points / 2 ? i : points - i;
+    envelope_[i] =
+        damp_points > 0.0f ? std::min(distance * inv_damp, 1.0f) : 1.0f;
+  }
+}
+
+const float *WaveSynth::Synthesize(const WaveComponent *components,
+                                   size_t count, float radians_per_hz,
+                                   float phase, float damp_points,
+                                   size_t points) {
+  UpdateEnvelope(damp_points, points);
+  wave_.assign(points, 0.0f);
+  float *wave = wave_.data();
+
+  for (size_t c = 0; c < count; ++c) {
+    const float amplitude = components[c].amplitude;
+    const float step = radians_per_hz * components[c].frequency;
+    const float step_cos = std::cos(step);
+    const float step_sin = std::sin(step);
+    for (size_t start = 0; start < points; start += kResyncInterval) {
+      // sin and cos of start * step + phase, in double so the exact restart
+      // does not lose precision far from the origin.
+      const double angle = double(start) * step + phase;
+      float re = amplitude * static_cast<float>(std::cos(angle));
+      float im = amplitude * static_cast<float>(std::sin(angle));
+      const size_t end = std::min(start + kResyncInterval, points);
+      for (size_t i = start; i < end; ++i) {
+        wave[i] += im;
+        const float next_re = re * step_cos - im * step_sin;
+        im = im * step_cos + re * step_sin;
+        re = next_re;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < points; ++i)
+    wave[i] *= envelope_[i];
+  return wave;
+}
+
+} // namespace audio
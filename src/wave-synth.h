@@ -0,0 +1,45 @@
+#pragma once
+#include "processed-audio.h"
+#include <cstddef>
+#include <vector>
+
+namespace audio {
+
+// Upper bound on the sinusoids a wave is built from.
+constexpr size_t kMaxWaveComponents = 64;
+
+struct WaveComponent {
+  float amplitude;
+  float frequency;
+};
+
+// The k loudest bins of buffer.magnitudes, loudest first. A fixed capacity
+// min-heap of (amplitude, bin) pairs keeps the scan at one compare per bin
+// and nothing is allocated. With interpolate, frequency and amplitude of
+// every peak are refined by a parabola through its two neighbours. Returns
+// the number of components written to out, at most kMaxWaveComponents.
+size_t loudestComponents(ProcessedAudioView buffer, size_t k,
+                         bool interpolate, WaveComponent *out);
+
+// Sums sinusoids over a row of points with one complex phasor per component,
+// advanced by a rotation per point instead of a sinf per point and
+// component. The output row and the edge damping envelope are kept between
+// calls.
+class WaveSynth {
+public:
+  // wave[i] = envelope[i] * sum amplitude * sin(i * w + phase), where
+  // w = radians_per_hz * frequency. The envelope ramps from 0 to 1 over
+  // damp_points points at both ends. Returns points values.
+  const float *Synthesize(const WaveComponent *components, size_t count,
+                          float radians_per_hz, float phase,
+                          float damp_points, size_t points);
+
+private:
+  void UpdateEnvelope(float damp_points, size_t points);
+
+  std::vector<float> wave_;
+  std::vector<float> envelope_;
+  float damp_points_ = -1.0f;
+};
+
+} // namespace audio
@@ -0,0 +1,77 @@
+#include "audio-processing.h"
+#include "processed-audio.h"
+#include "spectrum-analyzer.h"
+#include "stft.h"
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// The compile-time specialised multichannel analysis must match the runtime
+// sized one exactly, it is what AudioProcessor runs for the common sizes.
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const char *what) {
+  if (!condition) {
+    fprintf(stderr, "FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+bool sameBuffer(const audio::ProcessedAudioBuffer &a,
+                const audio::ProcessedAudioBuffer &b) {
+  return a.magnitudes == b.magnitudes &&
+         a.band_amplitudes == b.band_amplitudes &&
+         a.band_frequencies == b.band_frequencies &&
+         a.max_amplitude == b.max_amplitude &&
+         a.avg_amplitude == b.avg_amplitude &&
+         a.frequencies.data() == b.frequencies.data();
+}
+
+template <size_t size, size_t channels> void testMatchesRuntime() {
+  constexpr size_t rate = 48000;
+  std::vector<std::vector<float>> rows(channels, std::vector<float>(size));
+  std::vector<const float *> pointers;
+  for (size_t c = 0; c < channels; ++c) {
+    for (size_t i = 0; i < size; ++i)
+      rows[c][i] = std::sin(0.05f * (c + 1) * i) + 0.3f * std::sin(0.7f * i);
+    pointers.push_back(rows[c].data());
+  }
+  const audio::StftFrame frame{.channels = pointers.data(),
+                               .channel_count = channels,
+                               .size = size};
+
+  audio::ProcessedAudioFrame runtime(size / 2 + 1), fixed(size / 2 + 1);
+  audio::computeFFTMultichannel(frame, rate, runtime);
+  audio::computeFFTMultichannelFixed<size, channels>(frame, rate, fixed);
+  check(fixed.channel_count == channels, "wrong channel count");
+  for (size_t c = 0; c < channels; ++c)
+    check(sameBuffer(runtime.channels[c], fixed.channels[c]),
+          "channel spectra differ");
+  check(sameBuffer(runtime.mid, fixed.mid), "mid spectra differ");
+  check(sameBuffer(runtime.side, fixed.side), "side spectra differ");
+
+  auto analyzer = audio::makeSpectrumAnalyzer(size, channels);
+  check(analyzer->WindowSize() == size && analyzer->Channels() == channels,
+        "analyzer built for the wrong configuration");
+  audio::ProcessedAudioFrame wrapped(size / 2 + 1);
+  analyzer->Analyze(frame, rate, wrapped);
+  check(sameBuffer(runtime.mid, wrapped.mid), "wrapper spectra differ");
+}
+
+} // namespace
+
+int main() {
+  testMatchesRuntime<1024, 1>();
+  testMatchesRuntime<1024, 2>();
+  testMatchesRuntime<4096, 2>();
+  // Falls back to the runtime path.
+  auto analyzer = audio::makeSpectrumAnalyzer(3000, 6);
+  check(analyzer->WindowSize() == 3000 && analyzer->Channels() == 6,
+        "fallback analyzer built for the wrong configuration");
+  if (failures == 0)
+    printf("fixed fft: ok\n");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+#include "analysis-scheduler.h"
+#include "analysis-worker.h"
+#include "loudness-meter.h"
+#include "stft.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Stale input dropped by an AnalysisWorker that fell behind: frames after the
+// drop must be made of fresh input only and say so, and the loudness meter
+// must keep its integration across the restart.
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const char *what) {
+  if (!condition) {
+    fprintf(stderr, "FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+struct SeenFrame {
+  // A ramp is pushed, so every sample is its own index.
+  float first;
+  float newest;
+  bool contiguous;
+  bool discontinuity;
+};
+
+void testWorkerDrop(audio::AnalysisScheduler *scheduler) {
+  const audio::StftOptions stft{.window_size = 1024, .hop_size = 256};
+  std::vector<SeenFrame> seen;
+  audio::AnalysisWorker worker(
+      "stale-test", stft, 1 << 16,
+      [&](const audio::StftFrame &frame) {
+        const float *row = frame.channels[0];
+        bool contiguous = true;
+        for (size_t i = 1; i < frame.size; ++i)
+          contiguous = contiguous && row[i] == row[i - 1] + 1.0f;
+        seen.push_back({row[0], row[frame.size - 1], contiguous,
+                        frame.discontinuity});
+        // Far slower than the input, so the ring backs up.
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+      },
+      {.scheduler = scheduler, .max_backlog_hops = 2});
+  worker.Start();
+
+  std::vector<float> quantum(256);
+  float next = 0.0f;
+  for (int q = 0; q < 400; ++q) {
+    for (float &sample : quantum)
+      sample = next++;
+    worker.Push(quantum.data(), quantum.size(), 1);
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  worker.Stop();
+  const auto stats = worker.GetStats();
+
+  check(stats.dropped_samples == 0, "ring overran, drop not exercised");
+  check(stats.stale_samples > 0, "no stale input was dropped");
+  check(!seen.empty() && seen.back().newest == next - 1.0f,
+        "last frame is not the newest input");
+  size_t discontinuities = 0;
+  for (size_t i = 0; i < seen.size(); ++i) {
+    // No window straddles a gap, whether or not one was just skipped.
+    check(seen[i].contiguous, "window spliced across dropped input");
+    if (i == 0)
+      continue;
+    if (seen[i].discontinuity) {
+      discontinuities++;
+      check(seen[i].first > seen[i - 1].newest,
+            "discontinuity frame overlaps the previous one");
+    } else {
+      check(seen[i].newest == seen[i - 1].newest + stft.hop_size,
+            "frames without a discontinuity are not one hop apart");
+    }
+  }
+  check(discontinuities > 0, "drops were not flagged");
+}
+
+void testLoudnessRestart() {
+  constexpr size_t rate = 48000;
+  const audio::StftOptions options{.window_size = 4800, .hop_size = 4800};
+  audio::Stft stft(options);
+  audio::LoudnessMeter meter;
+  audio::LevelInfo levels;
+  std::vector<float> samples(options.hop_size);
+  const float *rows[] = {samples.data()};
+  size_t n = 0;
+  auto push = [&](float seconds) {
+    for (size_t s = 0; s < seconds * rate; s += samples.size()) {
+      for (float &sample : samples)
+        sample = 0.1f * std::sin(2.0f * float(M_PI) * 997.0f * n++ / rate);
+      stft.Push(rows, samples.size(), [&](const audio::StftFrame &frame) {
+        if (frame.discontinuity)
+          meter.Restart();
+        meter.Process(frame, rate, levels);
+      });
+    }
+  };
+
+  // A -20 dBFS sine reads -23 LUFS on one channel.
+  push(3.0f);
+  const float integrated = levels.integrated_lufs;
+  check(std::abs(integrated + 23.0f) < 0.1f, "integrated loudness off");
+  stft.Restart();
+  push(0.1f);
+  check(levels.integrated_lufs == integrated,
+        "integration lost across a restart");
+  check(std::abs(levels.momentary_lufs + 23.0f) < 0.5f,
+        "momentary loudness off after a restart");
+}
+
+} // namespace
+
+int main() {
+  testWorkerDrop(nullptr);
+  {
+    audio::AnalysisScheduler scheduler({.threads = 2});
+    testWorkerDrop(&scheduler);
+  }
+  testLoudnessRestart();
+  if (failures == 0)
+    printf("stale drop: ok\n");
+  return failures == 0 ? 0 : 1;
+}